@@ -7,10 +7,28 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <numeric>
+
+// Define this to run the benchmark of the streaming output against the original vector of permutations. Undefine for codeeval submission
+//#define do_benchmark
+
+#if defined do_benchmark
+#include <chrono>
+#include <streambuf>
+#include <sstream>
+#endif
 
 using std::string;
 using std::vector;
 
+// Below this many permutations a line isn't worth sharing out between threads
+const uint64_t parallelThreshold = 1000000;
+
 
 // Perform a generic operation on each line in a file
 void forEachLineInFile(const string &filename, void(*processFunc)(const string &line));
@@ -18,22 +36,51 @@ void forEachLineInFile(const string &filename, void(*processFunc)(const string &
 // Our generic function
 void processLine(const string &value);
 
+// The original output, every permutation gathered in a list, sorted and then written out. Only benchmark() uses it now, to compare
+// streamPermutations() with
+
 // Get a list of permutations for the given string value
 vector<string> getPermutations(string &value);
 
 // Sort a list of strings
 void sortStrings(vector<string> &list, bool(*sortFunc)(const string &, const string &));
 
-// Sorting predicate: digits < upper case letters < lower case letters
+// Sorting predicate: digits < upper case letters < lower case letters, and bytes compared as unsigned
 bool sortByDigitUpperLower(const string &, const string &);
 
 // Output a list of strings, comma delimited
 void csvOutput(const vector<string> &list, std::ostream &out);
 
+// Output the permutations of the given string value comma delimited, as they are generated
+void streamPermutations(string &value, std::ostream &out);
+
+// Number of distinct permutations of the characters of the given string value, which may repeat. Up to 20 characters
+uint64_t countPermutations(const string &value);
+
+// The k-th (zero-based) permutation in lexicographic order of the characters of the given sorted value, or an empty string if there
+// aren't that many
+string nthPermutation(const string &sorted, uint64_t k);
+
+// Zero-based position of the given permutation in the lexicographic order of all permutations of its characters
+uint64_t rankOf(const string &perm);
+
+// As streamPermutations(), but sharing the permutations out between threads in blocks, and outputting the blocks in order
+void parallelPermutations(const string &value, std::ostream &out, unsigned threads);
+
+#if defined do_benchmark
+// Time both ways of outputting the permutations of strings of increasing length
+void benchmark();
+#endif
+
 
 // the main function
 int main(int argc, char* argv[])
 {
+#if defined do_benchmark
+	benchmark();
+	return 0;
+#endif
+
 	if (argc > 1)
 	{
 		string filename(argv[1]);
@@ -65,9 +112,11 @@ void processLine(const string &line)
 	string value = line.substr(0, line.find_last_not_of(' ') + 1); // remove any trailing spaces just in case
 	if (!value.empty())
 	{
-		vector<string> perms = getPermutations(value);
-		sortStrings(perms, &sortByDigitUpperLower);
-		csvOutput(perms, std::cout);
+		unsigned threads = std::thread::hardware_concurrency();
+		if (threads > 1 && value.size() <= 20 && countPermutations(value) >= parallelThreshold)
+			parallelPermutations(value, std::cout, threads);
+		else
+			streamPermutations(value, std::cout);
 	}
 }
 
@@ -105,4 +154,317 @@ void csvOutput(const vector<string> &list, std::ostream &out)
 		}
 		out << formatted.substr(0, formatted.size() - 1) << "\n"; // output with trailing comma removed
 	}
-}
\ No newline at end of file
+}
+
+// Order of the characters as unsigned bytes, which is the order std::string::compare() puts them in whether char is signed or not
+static bool byteLess(char a, char b)
+{
+	return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+}
+
+void streamPermutations(string &value, std::ostream &out)
+{
+	const size_t flushSize = 1 << 16;
+
+	// std::next_permutation() from the sorted value gives lexicographic order, so there's nothing to sort and nothing need be kept
+	std::sort(value.begin(), value.end(), byteLess);
+
+	string buffer;
+	buffer.reserve(flushSize + value.size() + 2);
+	buffer += value;
+
+	while (std::next_permutation(value.begin(), value.end(), byteLess))
+	{
+		buffer += ',';
+		buffer += value;
+
+		if (buffer.size() >= flushSize)
+		{
+			out.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+	}
+
+	buffer += '\n';
+	out.write(buffer.data(), buffer.size());
+}
+
+// Position of a character in the order of byteLess()
+static int charIndex(char c)
+{
+	return static_cast<unsigned char>(c);
+}
+
+static char indexChar(int index)
+{
+	return static_cast<char>(static_cast<unsigned char>(index));
+}
+
+// Occurrences of each character, indexed by charIndex()
+static std::array<uint64_t, 256> characterCounts(const string &value)
+{
+	std::array<uint64_t, 256> counts{};
+	for (char c : value)
+		counts[charIndex(c)]++;
+	return counts;
+}
+
+// a * b / d, when that is known to be a whole number, without overflowing so long as it fits. Once the common factor of a and d is
+// taken out, what is left of d must divide b
+static uint64_t mulDiv(uint64_t a, uint64_t b, uint64_t d)
+{
+	uint64_t g = std::gcd(a, d);
+	return (a / g) * (b / (d / g));
+}
+
+uint64_t countPermutations(const string &value)
+{
+	// multinomial n! / (c1! c2! ...), built up one character at a time so every intermediate is exact: total * n / c
+	std::array<uint64_t, 256> seen{};
+	uint64_t total = 1;
+	uint64_t n = 0;
+	for (char c : value)
+	{
+		n++;
+		seen[charIndex(c)]++;
+		total = mulDiv(total, n, seen[charIndex(c)]);
+	}
+	return total;
+}
+
+string nthPermutation(const string &sorted, uint64_t k)
+{
+	std::array<uint64_t, 256> counts = characterCounts(sorted);
+	uint64_t remaining = sorted.size();
+	uint64_t total = countPermutations(sorted);
+
+	if (k >= total)
+		return string();
+
+	string perm;
+	perm.reserve(sorted.size());
+	while (remaining > 0)
+	{
+		// step over the blocks of permutations starting with each smaller character
+		for (int c = 0; c < 256; ++c)
+		{
+			if (counts[c] == 0)
+				continue;
+
+			uint64_t block = mulDiv(total, counts[c], remaining);
+			if (k < block)
+			{
+				perm += indexChar(c);
+				counts[c]--;
+				remaining--;
+				total = block;
+				break;
+			}
+			k -= block;
+		}
+	}
+	return perm;
+}
+
+uint64_t rankOf(const string &perm)
+{
+	std::array<uint64_t, 256> counts = characterCounts(perm);
+	uint64_t remaining = perm.size();
+	uint64_t total = countPermutations(perm);
+
+	uint64_t rank = 0;
+	for (char ch : perm)
+	{
+		int p = charIndex(ch);
+
+		// count the permutations starting with each smaller character
+		for (int c = 0; c < p; ++c)
+		{
+			if (counts[c] != 0)
+				rank += mulDiv(total, counts[c], remaining);
+		}
+
+		total = mulDiv(total, counts[p], remaining);
+		counts[p]--;
+		remaining--;
+	}
+	return rank;
+}
+
+void parallelPermutations(const string &value, std::ostream &out, unsigned threads)
+{
+	const uint64_t blockSize = 1 << 14;
+
+	string sorted = value;
+	std::sort(sorted.begin(), sorted.end(), byteLess);
+	uint64_t total = countPermutations(sorted);
+
+	// The threads are started once. Each round, every thread fills its own buffer with one block of consecutive permutations, the
+	// t-th block of the round. Here the buffers are written in order, each thread waiting for its buffer to be written before
+	// filling it with its block of the next round
+	threads = std::max(1u, threads);
+
+	struct Slot
+	{
+		string buffer;
+		uint64_t filled = 0; // rounds
+		uint64_t written = 0;
+	};
+	vector<Slot> slots(threads);
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	auto work = [&](unsigned t)
+	{
+		for (uint64_t round = 0; ; ++round)
+		{
+			uint64_t start = (round * threads + t) * blockSize;
+			if (start >= total)
+				return;
+			uint64_t end = std::min(total, start + blockSize);
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]() { return slots[t].written == round; });
+			}
+
+			string &buffer = slots[t].buffer;
+			buffer.clear();
+
+			string perm = nthPermutation(sorted, start);
+			buffer.reserve(blockSize * (perm.size() + 1));
+			buffer += perm;
+			for (uint64_t k = start + 1; k < end; ++k)
+			{
+				std::next_permutation(perm.begin(), perm.end(), byteLess);
+				buffer += ',';
+				buffer += perm;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slots[t].filled = round + 1;
+			}
+			changed.notify_all();
+		}
+	};
+
+	vector<std::thread> pool;
+	for (unsigned t = 0; t < threads; ++t)
+		pool.emplace_back(work, t);
+
+	for (uint64_t round = 0; round * threads * blockSize < total; ++round)
+	{
+		for (unsigned t = 0; t < threads && (round * threads + t) * blockSize < total; ++t)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&]() { return slots[t].filled > round; });
+			}
+
+			if (round != 0 || t != 0)
+				out << ',';
+			out.write(slots[t].buffer.data(), slots[t].buffer.size());
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slots[t].written = round + 1;
+			}
+			changed.notify_all();
+		}
+	}
+
+	for (auto &thread : pool)
+		thread.join();
+
+	out << '\n';
+}
+
+#if defined do_benchmark
+// Discards everything written to it, just counting the characters
+class CountingBuffer : public std::streambuf
+{
+public:
+	size_t count = 0;
+
+protected:
+	int_type overflow(int_type c) override
+	{
+		count++;
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char *, std::streamsize n) override
+	{
+		count += static_cast<size_t>(n);
+		return n;
+	}
+};
+
+void benchmark()
+{
+	// the outputs themselves compared first, for characters with the high bit set too, which std::string::compare() orders as unsigned
+	for (string input : { string("hat"), string("Zu6"), string("\xe9" "a\xe9" "b1"), string("\xe9\x80" "abc\xff" "d1") })
+	{
+		std::ostringstream vectorOut;
+		string value = input;
+		vector<string> perms = getPermutations(value);
+		sortStrings(perms, &sortByDigitUpperLower);
+		csvOutput(perms, vectorOut);
+
+		std::ostringstream streamOut;
+		value = input;
+		streamPermutations(value, streamOut);
+
+		if (vectorOut.str() != streamOut.str())
+			std::cout << "MISMATCH of the streamed permutations of " << input << "\n";
+
+		for (unsigned threads : { 2u, 3u, 7u })
+		{
+			std::ostringstream parallelOut;
+			parallelPermutations(input, parallelOut, threads);
+			if (parallelOut.str() != streamOut.str())
+				std::cout << "MISMATCH of the permutations of " << input << " by " << threads << " threads\n";
+		}
+	}
+
+	const string alphabet = "0123456789AB";
+
+	for (size_t length = 6; length <= 11; ++length)
+	{
+		string input = alphabet.substr(0, length);
+
+		auto start = std::chrono::steady_clock::now();
+		CountingBuffer vectorBuffer;
+		std::ostream vectorOut(&vectorBuffer);
+		{
+			string value = input;
+			vector<string> perms = getPermutations(value);
+			sortStrings(perms, &sortByDigitUpperLower);
+			csvOutput(perms, vectorOut);
+		}
+		std::chrono::duration<double> vectorTime = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		CountingBuffer streamBuffer;
+		std::ostream streamOut(&streamBuffer);
+		{
+			string value = input;
+			streamPermutations(value, streamOut);
+		}
+		std::chrono::duration<double> streamTime = std::chrono::steady_clock::now() - start;
+
+		unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+		start = std::chrono::steady_clock::now();
+		CountingBuffer parallelBuffer;
+		std::ostream parallelOut(&parallelBuffer);
+		parallelPermutations(input, parallelOut, threads);
+		std::chrono::duration<double> parallelTime = std::chrono::steady_clock::now() - start;
+
+		std::cout << "length " << length << ": " << streamBuffer.count << " characters, vector " << vectorTime.count()
+			<< " s, streaming " << streamTime.count() << " s, speedup " << vectorTime.count() / streamTime.count()
+			<< ", " << threads << " threads " << parallelTime.count() << " s"
+			<< (vectorBuffer.count == streamBuffer.count && streamBuffer.count == parallelBuffer.count ? "" : " MISMATCH") << "\n";
+	}
+}
+#endif
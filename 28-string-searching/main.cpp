@@ -2,15 +2,36 @@
 // Also handles multiple wildcards, not required. Again complete overkill. 
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
 #include <ctime> 
 #include <cassert>
+#include <chrono>
+#include <random>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <bitset>
+#include <limits>
+
+#if defined __AVX2__ || defined __SSE2__
+#include <immintrin.h>
+#endif
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
 
 
 using std::string;
+using std::string_view;
 using std::vector;
 using std::ifstream;
 using std::cout;
@@ -19,37 +40,244 @@ using std::unordered_map;
 
 static const int64_t prime = 179424691;
 
+// Patterns shorter than this are searched for with the SIMD filter, longer ones with two-way. Longer ones risk many
+// near misses each compared in full, where two-way stays linear
+static const size_t simd_threshold = 256;
+
+// Bytes read at a time when streaming a text from a file, so memory stays bounded however large the file
+static const size_t stream_chunk_size = 1 << 24;
+
+// Texts at least this long are searched by all cores, each taking blocks of this size in turn
+static const size_t parallel_threshold = 1 << 24;
+static const size_t parallel_block_size = 1 << 20;
+
+// The random texts of the tests and benchmarks are drawn with this seed, so that runs are reproducible, mostly from these letters
+static const unsigned random_seed = 28;
+static const string_view letters = "abcdefghijklmnopqrstuvwxyz";
 
+
+// The ways of finding a literal pattern in a text
+enum class Engine { RabinKarp, TwoWay, Simd };
+
+
+// Views of the pattern and the text, so searching part of a text copies nothing
 struct Data
 {
-	string pattern, text;
+	string_view pattern, text;
+};
+
+
+// The literal segments of a wildcard query, split on each unescaped `*`, with `\*` taken to be a literal asterisk.
+// The segments are views into `buffer`, the unescaped query, so tokenising allocates nothing per segment
+struct Segments
+{
+	string buffer;
+	vector<string_view> parts;
+};
+
+
+// Rabin-Karp hash of a pattern, with the base it was hashed with and that base to the power of the pattern length - 1
+struct PatternHash
+{
+	int64_t x = 1;
+	int64_t y = 1;
+	int64_t hash = 0;
+
+	auto prepare(string_view pattern) -> void;
+};
+
+
+// Critical factorisation of a pattern for Crochemore-Perrin two-way matching, which is linear in time with constant space
+struct TwoWay
+{
+	ptrdiff_t ell = -1;
+	size_t period = 1;
+	bool periodic = false;
+
+	auto prepare(string_view pattern) -> void;
+	auto first(string_view pattern, string_view text) const -> size_t;
+};
+
+
+// A wildcard query tokenised once, with the engine for each segment chosen by its length and prepared, to be matched against many
+// texts without allocating. Segments are kept as offsets into the unescaped query, so the pattern can be copied and moved
+struct CompiledPattern
+{
+	struct Segment
+	{
+		size_t offset = 0;
+		size_t length = 0;
+		Engine engine = Engine::Simd;
+		PatternHash hash;
+		TwoWay two_way;
+	};
+
+	string buffer;
+	vector<Segment> segments;
+
+	CompiledPattern() = default;
+	explicit CompiledPattern(const string &query);
+	CompiledPattern(const string &query, Engine engine);
+
+	auto literal(size_t segment) const -> string_view { return string_view(buffer).substr(segments[segment].offset, segments[segment].length); }
+	auto find(size_t segment, string_view text) const -> size_t;
+	auto matches(string_view text) const -> bool;
+};
+
+
+// Aho-Corasick automaton over a set of literal patterns, as a full transition table
+struct Automaton
+{
+	vector<std::array<int32_t, 256>> next;
+	vector<int32_t> fail;
+	vector<int32_t> pattern; // pattern ending at each node, or -1
+	vector<int32_t> output;  // nearest node along the failure links at which a pattern ends, or 0
+
+	auto add(string_view literal) -> int32_t;
+	auto build() -> void;
+};
+
+
+// Bits with rank, one count of the set bits before each word
+struct BitVector
+{
+	vector<uint64_t> bits;
+	vector<uint32_t> ranks;
+
+	auto rank1(size_t i) const -> size_t;
+	auto rank0(size_t i) const -> size_t { return i - rank1(i); }
+};
+
+
+// Wavelet matrix over a sequence of values, for the smallest value at least some bound within a range of the sequence
+struct WaveletMatrix
+{
+	size_t levels = 0;
+	vector<BitVector> rows;
+	vector<size_t> zeros;
+
+	auto build(vector<uint32_t> values) -> void;
+	auto next_value(size_t l, size_t r, uint32_t bound) const -> size_t;
+	auto bytes() const -> size_t;
+};
+
+
+// Suffix array of a fixed text, built once (SA-IS) and then queried many times in O(pattern length * log n).
+// The suffix array is also kept as a wavelet matrix, to find the first occurrence at or after an offset.
+// SA-IS works in int32_t, so texts of 2^31 - 1 bytes or more can't be indexed
+struct SuffixIndex
+{
+	string text;
+	vector<uint32_t> sa;
+	WaveletMatrix positions;
+
+	static constexpr size_t max_length = static_cast<size_t>(std::numeric_limits<int32_t>::max()) - 1;
+
+	auto build(string source) -> bool;
+	auto range(string_view pattern) const -> std::pair<size_t, size_t>;
+	auto first_at_or_after(string_view pattern, size_t offset) const -> size_t;
+	auto is_substring(const string &query) const -> bool;
+	auto save(const string &filename) const -> bool;
+	auto load(const string &filename, const string &source) -> bool;
+	auto bytes() const -> size_t;
 };
 
 
 auto split(const string &value, char delimiter) -> vector<string>;
-auto replace_asterisk(const string &original, const string &search, const string &replacement) -> string;
+auto tokenise(const string &query, Segments &segments) -> void;
 auto is_substring(const string &source, const string &query) -> bool;
+auto match_all(const string &source, const vector<string> &queries) -> vector<bool>;
 auto mod(int64_t a, int64_t p) -> int64_t;
 auto random(int64_t low, int64_t high) -> int64_t;
-auto poly_hash(const string &S, size_t begin, size_t end, int64_t p, int64_t x) -> int64_t;
-auto poly_hash(const string &S, int64_t p, int64_t x) -> int64_t;
-auto are_equal(const string &pattern, const string &text, size_t off) -> bool;
-auto precompute_hashes(const string &T, size_t L, int64_t p, int64_t x) -> unordered_map<size_t, int64_t>;
+auto poly_hash(string_view S, size_t begin, size_t end, int64_t p, int64_t x) -> int64_t;
+auto poly_hash(string_view S, int64_t p, int64_t x) -> int64_t;
+auto are_equal(string_view pattern, string_view text, size_t off) -> bool;
+auto precompute_hashes(string_view T, size_t L, int64_t p, int64_t x) -> unordered_map<size_t, int64_t>;
+template<typename Found> void rabin_karp_scan(const Data &input, const PatternHash &pattern, Found found);
+template<typename Found> void rabin_karp_scan(const Data &input, Found found);
 auto rabin_karp(const Data &input) -> vector<size_t>;
+auto rabin_karp_first(const Data &input) -> size_t;
+auto rabin_karp_precomputed(const Data &input) -> vector<size_t>;
+auto simd_first(const Data &input) -> size_t;
+auto choose_engine(size_t length) -> Engine;
+auto find_first(const Data &input, Engine engine) -> size_t;
+auto sa_is(const vector<int32_t> &s, int32_t upper) -> vector<int32_t>;
+auto index_queries(int argc, char *argv[]) -> void;
+auto stream_match(std::istream &in, const vector<string> &queries, size_t chunk_size) -> vector<bool>;
+auto stream_queries(const string &textname, const string &queryname) -> void;
+auto match_rules(const string &rulesname, const string &logname) -> void;
+auto parallel_first(const Data &input, unsigned threads, size_t block_size = parallel_block_size) -> size_t;
+auto parallel_is_substring(const string &source, const string &query, unsigned threads, size_t block_size = parallel_block_size) -> bool;
 
+auto random_text(std::mt19937 &rng, size_t length, string_view alphabet) -> string;
 auto test_is_substring() -> void;
 auto test_split() -> void;
+auto test_tokenise() -> void;
+auto test_rabin_karp() -> void;
+auto test_match_all() -> void;
+auto test_simd_first() -> void;
+auto test_suffix_index() -> void;
+auto test_stream_match() -> void;
+auto test_parallel_first() -> void;
+auto test_compiled_pattern() -> void;
+auto benchmark_rabin_karp() -> void;
+auto benchmark_match_all() -> void;
+auto benchmark_engines() -> void;
+auto benchmark_suffix_index() -> void;
+auto benchmark_parallel() -> void;
+auto benchmark_compiled_pattern() -> void;
 
 int main(int argc, char *argv[])
 {
 	//test_split();
+	//test_tokenise();
 	//test_is_substring();
+	//test_rabin_karp();
+	//test_match_all();
+	//test_simd_first();
+	//test_suffix_index();
+	//test_stream_match();
+	//test_parallel_first();
+	//test_compiled_pattern();
+	//benchmark_rabin_karp();
+	//benchmark_match_all();
+	//benchmark_engines();
+	//benchmark_suffix_index();
+	//benchmark_parallel();
+	//benchmark_compiled_pattern();
 
-	if (argc > 1)
+	// a text file queried many times: main --index text queries [index]
+	if (argc > 3 && string(argv[1]) == "--index")
+		index_queries(argc, argv);
+	// a text file too large to hold in memory: main --stream text queries
+	else if (argc > 3 && string(argv[1]) == "--stream")
+		stream_queries(argv[2], argv[3]);
+	// a fixed set of queries, one to a line, against every line of a log: main --rules rules log
+	else if (argc > 3 && string(argv[1]) == "--rules")
+		match_rules(argv[2], argv[3]);
+	else if (argc > 1)
 	{
 		string filename(argv[1]);
 		ifstream fin(filename.c_str());
 
+		// consecutive lines with the same text are answered together, scanning the text just once for all their queries
+		string source;
+		vector<string> queries;
+		auto answer = [&]()
+		{
+			unsigned threads = std::thread::hardware_concurrency();
+			if (queries.size() == 1 && threads > 1 && source.size() >= parallel_threshold)
+				cout << std::boolalpha << parallel_is_substring(source, queries[0], threads) << "\n";
+			else if (queries.size() == 1)
+				cout << std::boolalpha << is_substring(source, queries[0]) << "\n";
+			else if (!queries.empty())
+			{
+				for (bool found : match_all(source, queries))
+					cout << std::boolalpha << found << "\n";
+			}
+			queries.clear();
+		};
+
 		if (fin.is_open())
 		{
 			string line;
@@ -60,10 +288,17 @@ int main(int argc, char *argv[])
 				if (!line.empty())
 				{
 					auto tokens = split(line, ',');
-					cout << std::boolalpha << is_substring(tokens[0], tokens[1]) << "\n";
+					if (tokens[0] != source)
+					{
+						answer();
+						source = tokens[0];
+					}
+					queries.push_back(tokens[1]);
 				}
 			}
 		}
+
+		answer();
 	}
 
 	return 0;
@@ -94,56 +329,285 @@ auto split(const string &value, char delimiter) -> vector<string>
 	return ret;
 }
 
-auto replace_asterisk(const string &original, const string &search, const string &replacement) -> string
+auto tokenise(const string &query, Segments &segments) -> void
 {
-	string text = original;
-	size_t pos = 0;
+	// reserved up front so the views taken below stay valid
+	segments.buffer.clear();
+	segments.buffer.reserve(query.size());
+	segments.parts.clear();
 
-	while (true)
+	size_t start = 0;
+	auto end_segment = [&]()
 	{
-		pos = text.find(search, pos);
-		if (pos == string::npos)
-			break;
+		if (segments.buffer.size() > start)
+			segments.parts.emplace_back(segments.buffer.data() + start, segments.buffer.size() - start);
+		start = segments.buffer.size();
+	};
 
-		text.replace(pos, search.length(), replacement);
-		pos += replacement.length();
+	for (size_t i = 0; i < query.size(); ++i)
+	{
+		if (query[i] == '\\' && i + 1 < query.size() && query[i + 1] == '*')
+		{
+			segments.buffer += '*';
+			++i;
+		}
+		else if (query[i] == '*')
+		{
+			end_segment();
+		}
+		else
+		{
+			segments.buffer += query[i];
+		}
 	}
-
-	return text;
+	end_segment();
 }
 
-// test whether text2 is a substring of text1
+// test whether the query, which may have wildcards, matches a substring of source
 auto is_substring(const string &source, const string &query) -> bool
 {
-	string text1 = replace_asterisk(source, "*", "!");
-	string text2 = replace_asterisk(query, "\\*", "!");
+	return CompiledPattern(query).matches(source);
+}
 
-	auto tokens = split(text2, '*');
+CompiledPattern::CompiledPattern(const string &query)
+{
+	Segments tokens;
+	tokenise(query, tokens);
 
-	size_t start = 0;
+	buffer = tokens.buffer;
+	for (const auto &part : tokens.parts)
+	{
+		Segment segment;
+		segment.offset = static_cast<size_t>(part.data() - tokens.buffer.data());
+		segment.length = part.length();
+		segment.engine = choose_engine(part.length());
+
+		if (segment.engine == Engine::RabinKarp)
+			segment.hash.prepare(part);
+		else if (segment.engine == Engine::TwoWay)
+			segment.two_way.prepare(part);
+
+		segments.push_back(segment);
+	}
+}
 
-	for (const auto &pattern : tokens)
+// with every segment searched for by the one engine
+CompiledPattern::CompiledPattern(const string &query, Engine engine)
+	: CompiledPattern(query)
+{
+	for (size_t k = 0; k < segments.size(); ++k)
 	{
-		if (pattern == "")
-			continue;
+		segments[k].engine = engine;
+		segments[k].hash.prepare(literal(k));
+		segments[k].two_way.prepare(literal(k));
+	}
+}
 
-		string text;
-		text.assign(text1, start, string::npos);
+// first occurrence of the given segment in the text, or npos
+auto CompiledPattern::find(size_t segment, string_view text) const -> size_t
+{
+	const Segment &s = segments[segment];
 
-		Data data;
-		data.text = text;
-		data.pattern = pattern;
-		auto occurences = rabin_karp(data);
+	Data data;
+	data.text = text;
+	data.pattern = literal(segment);
+
+	switch (s.engine)
+	{
+	case Engine::Simd:
+		return simd_first(data);
+	case Engine::TwoWay:
+		return s.two_way.first(data.pattern, text);
+	case Engine::RabinKarp:
+	default:
+	{
+		size_t first = string::npos;
+		rabin_karp_scan(data, s.hash, [&](size_t i)
+		{
+			first = i;
+			return false;
+		});
+		return first;
+	}
+	}
+}
 
-		if (occurences.empty())
+// each segment is looked for in what remains of the text after the previous segment's first occurrence
+auto CompiledPattern::matches(string_view text) const -> bool
+{
+	size_t start = 0;
+
+	for (size_t k = 0; k < segments.size(); ++k)
+	{
+		size_t occurence = find(k, text.substr(start));
+
+		if (occurence == string::npos)
 			return false;
 
-		start = start + occurences[0] + pattern.length();
+		start = start + occurence + segments[k].length;
 	}
 
 	return true;
 }
 
+auto Automaton::add(string_view literal) -> int32_t
+{
+	if (next.empty())
+	{
+		next.emplace_back();
+		next[0].fill(-1);
+		pattern.push_back(-1);
+	}
+
+	int32_t node = 0;
+	for (unsigned char c : literal)
+	{
+		if (next[node][c] < 0)
+		{
+			next[node][c] = static_cast<int32_t>(next.size());
+			next.emplace_back();
+			next.back().fill(-1);
+			pattern.push_back(-1);
+		}
+		node = next[node][c];
+	}
+
+	return node;
+}
+
+// failure and output links breadth first, and every missing transition filled in from the failure link
+auto Automaton::build() -> void
+{
+	if (next.empty())
+		add("");
+
+	fail.assign(next.size(), 0);
+	output.assign(next.size(), 0);
+
+	vector<int32_t> queue;
+	queue.reserve(next.size());
+
+	for (auto &target : next[0])
+	{
+		if (target < 0)
+			target = 0;
+		else
+			queue.push_back(target);
+	}
+
+	for (size_t q = 0; q < queue.size(); ++q)
+	{
+		int32_t node = queue[q];
+		int32_t link = fail[node];
+		output[node] = pattern[link] >= 0 ? link : output[link];
+
+		for (int c = 0; c < 256; ++c)
+		{
+			int32_t &target = next[node][c];
+			if (target < 0)
+			{
+				target = next[link][c];
+			}
+			else
+			{
+				fail[target] = next[link][c];
+				queue.push_back(target);
+			}
+		}
+	}
+}
+
+// is_substring() for many queries of the one source, scanning the source once.
+// Every literal segment of every query goes into one automaton, and each query waits on its next segment in turn
+auto match_all(const string &source, const vector<string> &queries) -> vector<bool>
+{
+	vector<Segments> segments(queries.size());
+	for (size_t q = 0; q < queries.size(); ++q)
+		tokenise(queries[q], segments[q]);
+
+	// the node each segment ends at, numbering the segments in order across all the queries
+	Automaton automaton;
+	vector<size_t> first(queries.size() + 1, 0);
+	vector<int32_t> nodes;
+	for (size_t q = 0; q < queries.size(); ++q)
+	{
+		first[q] = nodes.size();
+		for (const auto &part : segments[q].parts)
+			nodes.push_back(automaton.add(part));
+	}
+	first[queries.size()] = nodes.size();
+
+	// distinct patterns are numbered by the node they end at
+	int32_t patterns = 0;
+	for (int32_t node : nodes)
+	{
+		if (automaton.pattern[node] < 0)
+			automaton.pattern[node] = patterns++;
+	}
+	automaton.build();
+
+	// queries waiting on each pattern, the segment each query is at, and where in the source that segment may start
+	vector<vector<size_t>> waiting(patterns);
+	vector<size_t> segment(queries.size());
+	vector<size_t> earliest(queries.size(), 0);
+	vector<bool> found(queries.size(), false);
+	size_t remaining = 0;
+
+	for (size_t q = 0; q < queries.size(); ++q)
+	{
+		segment[q] = first[q];
+		if (segment[q] == first[q + 1])
+			found[q] = true;
+		else
+		{
+			waiting[automaton.pattern[nodes[segment[q]]]].push_back(q);
+			remaining++;
+		}
+	}
+
+	int32_t state = 0;
+	for (size_t i = 0; i < source.size() && remaining > 0; ++i)
+	{
+		state = automaton.next[state][static_cast<unsigned char>(source[i])];
+
+		int32_t node = automaton.pattern[state] >= 0 ? state : automaton.output[state];
+		for (; node != 0; node = automaton.output[node])
+		{
+			vector<size_t> &queue = waiting[automaton.pattern[node]];
+
+			for (size_t k = 0; k < queue.size(); )
+			{
+				size_t q = queue[k];
+				size_t length = segments[q].parts[segment[q] - first[q]].length();
+
+				// the first occurrence at or after where the previous segment ended moves the query on
+				if (i + 1 - length < earliest[q])
+				{
+					++k;
+					continue;
+				}
+
+				queue[k] = queue.back();
+				queue.pop_back();
+
+				earliest[q] = i + 1;
+				segment[q]++;
+				if (segment[q] == first[q + 1])
+				{
+					found[q] = true;
+					remaining--;
+				}
+				else
+				{
+					waiting[automaton.pattern[nodes[segment[q]]]].push_back(q);
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
 int64_t mod(int64_t a, int64_t p)
 {
 	return ((a % p) + p) % p;
@@ -151,12 +615,13 @@ int64_t mod(int64_t a, int64_t p)
 
 int64_t random(int64_t low, int64_t high)
 {
-	srand((unsigned)time(0));
+	// seeded once per thread rather than on every call
+	thread_local std::mt19937_64 generator(static_cast<uint64_t>(time(0)) ^ std::hash<std::thread::id>()(std::this_thread::get_id()));
 
-	return low + (int64_t)(rand() * ((high - low) / RAND_MAX));
+	return std::uniform_int_distribution<int64_t>(low, high)(generator);
 }
 
-int64_t poly_hash(const string &S, size_t begin, size_t end, int64_t p, int64_t x)
+int64_t poly_hash(string_view S, size_t begin, size_t end, int64_t p, int64_t x)
 {
 	int64_t hash = 0;
 	for (size_t i = end; i > begin; --i)
@@ -166,35 +631,24 @@ int64_t poly_hash(const string &S, size_t begin, size_t end, int64_t p, int64_t
 	return hash;
 }
 
-int64_t poly_hash(const string &S, int64_t p, int64_t x)
+int64_t poly_hash(string_view S, int64_t p, int64_t x)
 {
 	return poly_hash(S, 0, S.length(), p, x);
 }
 
-bool are_equal(const string &pattern, const string &text, size_t off)
+bool are_equal(string_view pattern, string_view text, size_t off)
 {
-	const char *p = pattern.c_str();
-	const char *t = text.c_str() + off;
-
-	while (*p != '\0')
-	{
-		if (*p != *t)
-			return false;
-		++p;
-		++t;
-	}
-
-	return true;
+	return text.compare(off, pattern.length(), pattern) == 0;
 }
 
-unordered_map<size_t, int64_t> precompute_hashes(const string &T, size_t L, int64_t p, int64_t x)
+unordered_map<size_t, int64_t> precompute_hashes(string_view T, size_t L, int64_t p, int64_t x)
 {
 	size_t TL = T.length();
 
 	unordered_map<size_t, int64_t> H;
 	H.reserve(TL - L + 1);
 
-	string S = T.substr(TL - L);
+	string_view S = T.substr(TL - L);
 	H[TL - L] = poly_hash(S, p, x);
 
 	int64_t y = 1;
@@ -212,92 +666,1039 @@ unordered_map<size_t, int64_t> precompute_hashes(const string &T, size_t L, int6
 	return H;
 }
 
-vector<size_t> rabin_karp(const Data &input)
+// Rabin-Karp with the hash rolled along the text as it is compared, so only O(1) state is kept.
+// The window hash is the polynomial T[i] x^(L-1) + ... + T[i+L-1], so a character drops off the front and one is added at the back
+auto PatternHash::prepare(string_view pattern) -> void
 {
-	vector<size_t> ans;
+	int64_t p = prime;
+	x = random(1, p - 1);
+
+	// x^(L-1), the weight of the character leaving the window
+	y = 1;
+	for (size_t i = 1; i < pattern.length(); ++i)
+		y = y * x % p;
+
+	hash = 0;
+	for (unsigned char c : pattern)
+		hash = (hash * x + c) % p;
+}
 
-	const string &P = input.pattern;
-	const string &T = input.text;
+// `found(i)` is called with each occurrence in turn, until it returns false. The pattern has been hashed already
+template<typename Found>
+void rabin_karp_scan(const Data &input, const PatternHash &pattern, Found found)
+{
+	string_view P = input.pattern;
+	string_view T = input.text;
 	const size_t L = P.length();
 	const size_t TL = T.length();
 
-	if (L <= TL)
+	// the empty pattern occurs everywhere, and has no window to roll
+	if (L == 0)
+	{
+		for (size_t i = 0; i <= TL; ++i)
+		{
+			if (!found(i))
+				return;
+		}
+	}
+	else if (L <= TL)
 	{
 		int64_t p = prime;
-		int64_t x = random(1, p - 1);
+		int64_t x = pattern.x;
+		int64_t y = pattern.y;
 
-		int64_t pHash = poly_hash(P, p, x);
-
-		unordered_map<size_t, int64_t> H = precompute_hashes(T, L, p, x);
+		int64_t pHash = pattern.hash;
+		int64_t tHash = 0;
+		for (size_t i = 0; i < L; ++i)
+			tHash = (tHash * x + static_cast<unsigned char>(T[i])) % p;
 
-		for (size_t i = 0; i <= TL - L; ++i)
+		for (size_t i = 0; ; ++i)
 		{
-			int64_t tHash = H[i];
-
 			if (pHash == tHash)
 			{
-				if (are_equal(P, T, i))
-					ans.push_back(i);
+				if (are_equal(P, T, i) && !found(i))
+					return;
 			}
+
+			if (i == TL - L)
+				break;
+
+			int64_t leaving = static_cast<unsigned char>(T[i]) * y % p;
+			tHash = (tHash + p - leaving) % p;
+			tHash = (tHash * x + static_cast<unsigned char>(T[i + L])) % p;
 		}
 	}
+}
+
+template<typename Found>
+void rabin_karp_scan(const Data &input, Found found)
+{
+	PatternHash pattern;
+	pattern.prepare(input.pattern);
+	rabin_karp_scan(input, pattern, found);
+}
+
+// every occurrence of the pattern in the text
+vector<size_t> rabin_karp(const Data &input)
+{
+	vector<size_t> ans;
+
+	rabin_karp_scan(input, [&](size_t i)
+	{
+		ans.push_back(i);
+		return true;
+	});
 
 	return ans;
 }
 
-auto test_is_substring() -> void
+// the first occurrence of the pattern in the text, or npos
+size_t rabin_karp_first(const Data &input)
 {
-	auto Test = [](bool expected, const string &a, const string &b)
+	size_t first = string::npos;
+
+	rabin_karp_scan(input, [&](size_t i)
 	{
-		assert(is_substring(a, b) == expected);
-	};
+		first = i;
+		return false;
+	});
 
-	Test(true, "Hello", "ell");
-	Test(true, "This is good", "is");
-	Test(true, "CodeEval", "C*Eval");
-	Test(false, "CodeEval", "C\\*Eval");
-	Test(true, "Code*Eval", "Code\\*Eval");
-	Test(false, "Old", "Young");
-	Test(true, "the quick brown fox jumps over the lazy dog", "dog"); 
-	Test(true, "the quick brown fox jumps over the lazy dog", "quick*fox");
-	Test(false, "the quick brown fox jumps over the lazy dog", "quick\\*fox");
-	Test(true, "the quick*fox jumps over the lazy dog", "quick\\*fox");
-	Test(true, "123456789987654321", "7*9");
-	Test(true, "123456789987654321", "1*1");
-	Test(true, "123456789987654321", "1*");
-	Test(true, "123456789987654321", "*1");
-	Test(true, "anything whatsoever", "*");
-	Test(false, "anything whatsoever", "\\*");
-	Test(true, "*", "*");
-	Test(true, "*", "\\*");
-	Test(true, "abcdef*ghijkl", "f*g");
-	Test(true, "abcdef*ghijkl", "f\\*g");
-	Test(true, "abcdef*ghijkl", "d*i");
-	Test(false, "the quick brown fox jumps over the lazy dog", "lazy*quick");
-	Test(false, "the quiiiiick brown fox jumps over the laaaaazy dog", "quick*lazy");
-	Test(false, "the quiiiiick brown fox jumps over the laaaaazy dog", "lazy*quick");
-	Test(true, "the quickquickquick brown fox jumps over the lazylazylazy dog", "quick*lazy");
-	Test(true, "quickquickquick brown fox jumps over the lazylazylazy", "quick*lazy");
-	Test(true, "quickquickquicklazylazylazy", "quick*lazy");
-	Test(false, "lazylazylazyquickquickquick", "quick*lazy");
-	Test(false, "slowlazylazylazy", "quick*lazy");
-	Test(false, "quickquickquick123456789", "quick*lazy");
-	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "c*t");
-	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "t*c");
-	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "za");
-	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "z*a");
+	return first;
+}
 
+// Index of the lowest set bit of a mask that isn't zero
+static auto trailing_zeros(unsigned mask) -> size_t
+{
+#if defined _MSC_VER
+	unsigned long index = 0;
+	_BitScanForward(&index, mask);
+	return static_cast<size_t>(index);
+#else
+	return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+}
 
-	Test(false, "*So*eaE", "*JH*");
-	Test(true, "* So*eaE", "**");
-	Test(true, "blblah*", "blb*h*");
-	Test(false, "blah*", "blb*h*");
-	Test(false, "blah*", "blb*h");
-	Test(true, "CodeEval", "C*Eval");
-	Test(true, "CodeEval", "C*Ev*al");
-	Test(false, "CodeE*val", "C*Ev*al");
-	Test(false, "Old", "*Young*");
-	Test(false, "Old", "*ung*");
+// First occurrence of the pattern in the text, or npos. The first and last bytes of the pattern are compared against those of
+// 32 (AVX2) or 16 (SSE2) windows of text at a time, and only the windows where both agree are compared in full
+size_t simd_first(const Data &input)
+{
+	string_view P = input.pattern;
+	string_view T = input.text;
+	const size_t L = P.length();
+	const size_t TL = T.length();
+
+	if (L == 0)
+		return 0;
+	if (L > TL)
+		return string::npos;
+
+	const size_t windows = TL - L + 1;
+	const char *text = T.data();
+	size_t i = 0;
+
+#if defined __AVX2__
+	const __m256i first = _mm256_set1_epi8(P[0]);
+	const __m256i last = _mm256_set1_epi8(P[L - 1]);
+
+	for (; i + 32 <= windows; i += 32)
+	{
+		__m256i front = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i));
+		__m256i back = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(text + i + L - 1));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(front, first), _mm256_cmpeq_epi8(back, last))));
+
+		while (mask != 0)
+		{
+			size_t candidate = i + trailing_zeros(mask);
+			if (are_equal(P, T, candidate))
+				return candidate;
+			mask &= mask - 1;
+		}
+	}
+#elif defined __SSE2__
+	const __m128i first = _mm_set1_epi8(P[0]);
+	const __m128i last = _mm_set1_epi8(P[L - 1]);
+
+	for (; i + 16 <= windows; i += 16)
+	{
+		__m128i front = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+		__m128i back = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i + L - 1));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(front, first), _mm_cmpeq_epi8(back, last))));
+
+		while (mask != 0)
+		{
+			size_t candidate = i + trailing_zeros(mask);
+			if (are_equal(P, T, candidate))
+				return candidate;
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	// scalar for what's left, or all of it without SIMD
+	for (; i < windows; ++i)
+	{
+		if (text[i] == P[0] && text[i + L - 1] == P[L - 1] && are_equal(P, T, i))
+			return i;
+	}
+
+	return string::npos;
+}
+
+Engine choose_engine(size_t length)
+{
+	return length < simd_threshold ? Engine::Simd : Engine::TwoWay;
+}
+
+// The position and period of a maximal suffix of the pattern, under the usual order of bytes or its reverse
+static auto maximal_suffix(string_view x, bool reversed, size_t &period) -> ptrdiff_t
+{
+	ptrdiff_t m = static_cast<ptrdiff_t>(x.length());
+	ptrdiff_t ms = -1;
+	ptrdiff_t j = 0;
+	ptrdiff_t k = 1;
+	ptrdiff_t p = 1;
+
+	while (j + k < m)
+	{
+		unsigned char a = x[j + k];
+		unsigned char b = x[ms + k];
+		if (reversed)
+			std::swap(a, b);
+
+		if (a < b)
+		{
+			j += k;
+			k = 1;
+			p = j - ms;
+		}
+		else if (a == b)
+		{
+			if (k != p)
+				++k;
+			else
+			{
+				j += p;
+				k = 1;
+			}
+		}
+		else
+		{
+			ms = j;
+			j = ms + 1;
+			k = p = 1;
+		}
+	}
+
+	period = static_cast<size_t>(p);
+	return ms;
+}
+
+auto TwoWay::prepare(string_view pattern) -> void
+{
+	size_t p = 1;
+	size_t q = 1;
+	ptrdiff_t i = maximal_suffix(pattern, false, p);
+	ptrdiff_t j = maximal_suffix(pattern, true, q);
+
+	// the later of the two is a critical factorisation
+	ell = i > j ? i : j;
+	period = i > j ? p : q;
+
+	// the pattern is periodic when the left part recurs a period later
+	periodic = period + static_cast<size_t>(ell + 1) <= pattern.length() && pattern.compare(0, static_cast<size_t>(ell + 1), pattern, period, static_cast<size_t>(ell + 1)) == 0;
+	if (!periodic)
+		period = static_cast<size_t>(std::max(ell + 1, static_cast<ptrdiff_t>(pattern.length()) - ell - 1) + 1);
+}
+
+// First occurrence of the pattern in the text, or npos. The right part of the factorisation is matched left to right, then the left
+// part right to left. For periodic patterns the prefix already known to match after a shift by the period is remembered
+auto TwoWay::first(string_view x, string_view y) const -> size_t
+{
+	ptrdiff_t m = static_cast<ptrdiff_t>(x.length());
+	ptrdiff_t n = static_cast<ptrdiff_t>(y.length());
+	ptrdiff_t per = static_cast<ptrdiff_t>(period);
+
+	if (m == 0)
+		return 0;
+
+	ptrdiff_t j = 0;
+	ptrdiff_t memory = -1;
+	while (j <= n - m)
+	{
+		ptrdiff_t i = std::max(ell, memory) + 1;
+		while (i < m && x[i] == y[i + j])
+			++i;
+
+		if (i >= m)
+		{
+			i = ell;
+			while (i > memory && x[i] == y[i + j])
+				--i;
+			if (i <= memory)
+				return static_cast<size_t>(j);
+
+			j += per;
+			memory = periodic ? m - per - 1 : -1;
+		}
+		else
+		{
+			j += i - ell;
+			memory = -1;
+		}
+	}
+
+	return string::npos;
+}
+
+size_t find_first(const Data &input, Engine engine)
+{
+	switch (engine)
+	{
+	case Engine::Simd:
+		return simd_first(input);
+	case Engine::TwoWay:
+	{
+		TwoWay two_way;
+		two_way.prepare(input.pattern);
+		return two_way.first(input.pattern, input.text);
+	}
+	case Engine::RabinKarp:
+	default:
+		return rabin_karp_first(input);
+	}
+}
+
+// The original Rabin-Karp, hashing every window into a table up front. Kept for benchmarking
+vector<size_t> rabin_karp_precomputed(const Data &input)
+{
+	vector<size_t> ans;
+
+	string_view P = input.pattern;
+	string_view T = input.text;
+	const size_t L = P.length();
+	const size_t TL = T.length();
+
+	if (L <= TL)
+	{
+		int64_t p = prime;
+		int64_t x = random(1, p - 1);
+
+		int64_t pHash = poly_hash(P, p, x);
+
+		unordered_map<size_t, int64_t> H = precompute_hashes(T, L, p, x);
+
+		for (size_t i = 0; i <= TL - L; ++i)
+		{
+			int64_t tHash = H[i];
+
+			if (pHash == tHash)
+			{
+				if (are_equal(P, T, i))
+					ans.push_back(i);
+			}
+		}
+	}
+
+	return ans;
+}
+
+// Suffix array by induced sorting (SA-IS) of values in [0, upper]
+auto sa_is(const vector<int32_t> &s, int32_t upper) -> vector<int32_t>
+{
+	// every index into s, and one past the end, must fit an int32_t
+	assert(s.size() < static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+
+	int32_t n = static_cast<int32_t>(s.size());
+	if (n == 0)
+		return {};
+	if (n == 1)
+		return { 0 };
+	if (n == 2)
+		return s[0] < s[1] ? vector<int32_t>{ 0, 1 } : vector<int32_t>{ 1, 0 };
+
+	// S or L type of each suffix, and the start of each bucket's L and S parts
+	vector<int32_t> sa(n);
+	vector<bool> ls(n);
+	for (int32_t i = n - 2; i >= 0; --i)
+		ls[i] = s[i] == s[i + 1] ? ls[i + 1] : s[i] < s[i + 1];
+
+	vector<int32_t> sum_l(upper + 1);
+	vector<int32_t> sum_s(upper + 1);
+	for (int32_t i = 0; i < n; ++i)
+	{
+		if (!ls[i])
+			sum_s[s[i]]++;
+		else
+			sum_l[s[i] + 1]++;
+	}
+	for (int32_t i = 0; i <= upper; ++i)
+	{
+		sum_s[i] += sum_l[i];
+		if (i < upper)
+			sum_l[i + 1] += sum_s[i];
+	}
+
+	auto induce = [&](const vector<int32_t> &lms)
+	{
+		std::fill(sa.begin(), sa.end(), -1);
+		vector<int32_t> buf(upper + 1);
+
+		std::copy(sum_s.begin(), sum_s.end(), buf.begin());
+		for (int32_t d : lms)
+		{
+			if (d != n)
+				sa[buf[s[d]]++] = d;
+		}
+
+		std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+		sa[buf[s[n - 1]]++] = n - 1;
+		for (int32_t i = 0; i < n; ++i)
+		{
+			int32_t v = sa[i];
+			if (v >= 1 && !ls[v - 1])
+				sa[buf[s[v - 1]]++] = v - 1;
+		}
+
+		std::copy(sum_l.begin(), sum_l.end(), buf.begin());
+		for (int32_t i = n - 1; i >= 0; --i)
+		{
+			int32_t v = sa[i];
+			if (v >= 1 && ls[v - 1])
+				sa[--buf[s[v - 1] + 1]] = v - 1;
+		}
+	};
+
+	// the leftmost S type suffixes are sorted first, approximately, then exactly by recursing on their names
+	vector<int32_t> lms_map(n + 1, -1);
+	vector<int32_t> lms;
+	for (int32_t i = 1; i < n; ++i)
+	{
+		if (!ls[i - 1] && ls[i])
+		{
+			lms_map[i] = static_cast<int32_t>(lms.size());
+			lms.push_back(i);
+		}
+	}
+	int32_t m = static_cast<int32_t>(lms.size());
+
+	induce(lms);
+
+	if (m > 0)
+	{
+		vector<int32_t> sorted_lms;
+		sorted_lms.reserve(m);
+		for (int32_t v : sa)
+		{
+			if (lms_map[v] != -1)
+				sorted_lms.push_back(v);
+		}
+
+		vector<int32_t> rec_s(m);
+		int32_t rec_upper = 0;
+		rec_s[lms_map[sorted_lms[0]]] = 0;
+		for (int32_t i = 1; i < m; ++i)
+		{
+			int32_t l = sorted_lms[i - 1];
+			int32_t r = sorted_lms[i];
+			int32_t end_l = lms_map[l] + 1 < m ? lms[lms_map[l] + 1] : n;
+			int32_t end_r = lms_map[r] + 1 < m ? lms[lms_map[r] + 1] : n;
+
+			bool same = true;
+			if (end_l - l != end_r - r)
+				same = false;
+			else
+			{
+				while (l < end_l && s[l] == s[r])
+				{
+					l++;
+					r++;
+				}
+				if (l == n || s[l] != s[r])
+					same = false;
+			}
+
+			if (!same)
+				rec_upper++;
+			rec_s[lms_map[sorted_lms[i]]] = rec_upper;
+		}
+
+		vector<int32_t> rec_sa = sa_is(rec_s, rec_upper);
+		for (int32_t i = 0; i < m; ++i)
+			sorted_lms[i] = lms[rec_sa[i]];
+
+		induce(sorted_lms);
+	}
+
+	return sa;
+}
+
+// number of set bits in the word, portably
+static auto popcount(uint64_t word) -> size_t
+{
+	return std::bitset<64>(word).count();
+}
+
+auto BitVector::rank1(size_t i) const -> size_t
+{
+	size_t word = i / 64;
+	size_t bit = i % 64;
+	size_t rank = ranks[word];
+	if (bit != 0)
+		rank += popcount(bits[word] & ((uint64_t(1) << bit) - 1));
+	return rank;
+}
+
+// Each level holds one bit of every value, from the most significant down, the values being stably sorted by the bits above
+auto WaveletMatrix::build(vector<uint32_t> values) -> void
+{
+	uint32_t largest = 0;
+	for (uint32_t v : values)
+		largest = std::max(largest, v);
+
+	levels = 1;
+	while (levels < 32 && (largest >> levels) != 0)
+		levels++;
+
+	size_t n = values.size();
+	rows.assign(levels, BitVector());
+	zeros.assign(levels, 0);
+
+	vector<uint32_t> next(n);
+	for (size_t level = 0; level < levels; ++level)
+	{
+		size_t shift = levels - 1 - level;
+		BitVector &row = rows[level];
+		row.bits.assign(n / 64 + 1, 0);
+		row.ranks.assign(n / 64 + 1, 0);
+
+		// the bits are random, so this is all done without branching on them
+		for (size_t i = 0; i < n; ++i)
+			row.bits[i / 64] |= uint64_t((values[i] >> shift) & 1) << (i % 64);
+		for (size_t w = 1; w < row.bits.size(); ++w)
+			row.ranks[w] = row.ranks[w - 1] + static_cast<uint32_t>(popcount(row.bits[w - 1]));
+
+		// stable partition, zeros first
+		size_t z = n - row.ranks.back() - popcount(row.bits.back());
+		zeros[level] = z;
+		size_t o = z;
+		z = 0;
+		for (uint32_t v : values)
+		{
+			size_t bit = (v >> shift) & 1;
+			next[bit ? o : z] = v;
+			o += bit;
+			z += bit ^ 1;
+		}
+		values.swap(next);
+	}
+}
+
+// Smallest value at least `bound` among positions [l, r) of the sequence, or npos
+auto WaveletMatrix::next_value(size_t l, size_t r, uint32_t bound) const -> size_t
+{
+	// smallest value of all in [l, r) at this level and below, taking the zero side whenever it isn't empty
+	auto smallest = [this](size_t level, size_t l, size_t r, size_t value) -> size_t
+	{
+		for (; level < levels; ++level)
+		{
+			size_t l0 = rows[level].rank0(l);
+			size_t r0 = rows[level].rank0(r);
+			value <<= 1;
+			if (l0 < r0)
+			{
+				l = l0;
+				r = r0;
+			}
+			else
+			{
+				l = zeros[level] + (l - l0);
+				r = zeros[level] + (r - r0);
+				value |= 1;
+			}
+		}
+		return value;
+	};
+
+	if (l >= r || (levels < 32 && (bound >> levels) != 0))
+		return string::npos;
+
+	// follow the bits of `bound` down as far as possible, noting where a one could have been taken instead of one of its zeros
+	bool fallback = false;
+	size_t fallback_level = 0, fallback_l = 0, fallback_r = 0, fallback_value = 0;
+	size_t value = 0;
+
+	for (size_t level = 0; level < levels; ++level)
+	{
+		size_t shift = levels - 1 - level;
+		size_t l0 = rows[level].rank0(l);
+		size_t r0 = rows[level].rank0(r);
+		size_t l1 = zeros[level] + (l - l0);
+		size_t r1 = zeros[level] + (r - r0);
+
+		if (((bound >> shift) & 1) == 0)
+		{
+			if (l1 < r1)
+			{
+				fallback = true;
+				fallback_level = level + 1;
+				fallback_l = l1;
+				fallback_r = r1;
+				fallback_value = (value << 1) | 1;
+			}
+			l = l0;
+			r = r0;
+			value <<= 1;
+		}
+		else
+		{
+			l = l1;
+			r = r1;
+			value = (value << 1) | 1;
+		}
+
+		if (l >= r)
+			break;
+	}
+
+	if (l < r)
+		return value; // `bound` itself is there
+
+	if (!fallback)
+		return string::npos;
+
+	return smallest(fallback_level, fallback_l, fallback_r, fallback_value);
+}
+
+auto WaveletMatrix::bytes() const -> size_t
+{
+	size_t total = 0;
+	for (const auto &row : rows)
+		total += row.bits.size() * sizeof(uint64_t) + row.ranks.size() * sizeof(uint32_t);
+	return total;
+}
+
+// false, leaving the index empty, if the text is too long to index
+auto SuffixIndex::build(string source) -> bool
+{
+	text.clear();
+	sa.clear();
+	positions.build(sa);
+	if (source.size() > max_length)
+		return false;
+
+	text = std::move(source);
+
+	vector<int32_t> s(text.begin(), text.end());
+	for (auto &c : s)
+		c = static_cast<unsigned char>(c);
+
+	vector<int32_t> suffixes = sa_is(s, 255);
+	sa.assign(suffixes.begin(), suffixes.end());
+	positions.build(sa);
+	return true;
+}
+
+// The range of the suffix array whose suffixes start with the pattern, by binary search
+auto SuffixIndex::range(string_view pattern) const -> std::pair<size_t, size_t>
+{
+	string_view all(text);
+
+	auto lower = std::partition_point(sa.begin(), sa.end(), [&](uint32_t suffix)
+	{
+		return all.compare(suffix, pattern.length(), pattern) < 0;
+	});
+	auto upper = std::partition_point(lower, sa.end(), [&](uint32_t suffix)
+	{
+		return all.compare(suffix, pattern.length(), pattern) == 0;
+	});
+
+	return { static_cast<size_t>(lower - sa.begin()), static_cast<size_t>(upper - sa.begin()) };
+}
+
+auto SuffixIndex::first_at_or_after(string_view pattern, size_t offset) const -> size_t
+{
+	if (offset + pattern.length() > text.length())
+		return string::npos;
+
+	auto found = range(pattern);
+	return positions.next_value(found.first, found.second, static_cast<uint32_t>(offset));
+}
+
+// as the free is_substring(), the segments of the query being chained through the index
+auto SuffixIndex::is_substring(const string &query) const -> bool
+{
+	Segments segments;
+	tokenise(query, segments);
+
+	size_t start = 0;
+	for (const auto &pattern : segments.parts)
+	{
+		size_t occurence = first_at_or_after(pattern, start);
+		if (occurence == string::npos)
+			return false;
+
+		start = occurence + pattern.length();
+	}
+
+	return true;
+}
+
+// Marks the start of a saved index, and its version
+static const char index_magic[8] = { 'S', 'U', 'F', 'F', 'I', 'D', 'X', '1' };
+
+// The text and suffix array after a header and the text's length, the wavelet matrix being quick to rebuild from them on loading
+auto SuffixIndex::save(const string &filename) const -> bool
+{
+	std::ofstream fout(filename.c_str(), std::ios::binary);
+	uint64_t length = text.length();
+	fout.write(index_magic, sizeof(index_magic));
+	fout.write(reinterpret_cast<const char *>(&length), sizeof(length));
+	fout.write(text.data(), text.length());
+	fout.write(reinterpret_cast<const char *>(sa.data()), sa.size() * sizeof(uint32_t));
+	return fout.good();
+}
+
+// False, leaving the index empty, unless the file is a whole index of exactly the given text, its suffix array holding every
+// position of the text once. A stale or damaged file is rejected rather than answering for some other text
+auto SuffixIndex::load(const string &filename, const string &source) -> bool
+{
+	text.clear();
+	sa.clear();
+	positions.build(sa);
+
+	std::ifstream fin(filename.c_str(), std::ios::binary);
+	char magic[sizeof(index_magic)] = {};
+	uint64_t length = 0;
+	if (!fin.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), index_magic))
+		return false;
+	if (!fin.read(reinterpret_cast<char *>(&length), sizeof(length)) || length != source.length() || length > max_length)
+		return false;
+
+	string saved(length, '\0');
+	vector<uint32_t> suffixes(length);
+	fin.read(&saved[0], static_cast<std::streamsize>(length));
+	fin.read(reinterpret_cast<char *>(suffixes.data()), static_cast<std::streamsize>(length * sizeof(uint32_t)));
+	if (!fin || fin.peek() != std::char_traits<char>::eof() || saved != source)
+		return false;
+
+	vector<bool> seen(length, false);
+	for (uint32_t suffix : suffixes)
+	{
+		if (suffix >= length || seen[suffix])
+			return false;
+		seen[suffix] = true;
+	}
+
+	text = std::move(saved);
+	sa = std::move(suffixes);
+	positions.build(sa);
+	return true;
+}
+
+auto SuffixIndex::bytes() const -> size_t
+{
+	return text.size() + sa.size() * sizeof(uint32_t) + positions.bytes();
+}
+
+// The whole of one file is the text, each line of another a query of it. The index is loaded from, or else saved to, an optional third file.
+// An index file that isn't of this text is rebuilt. A text too long to index has each query scanned for instead.
+// Build time, index size and query latency go to stderr
+auto index_queries(int argc, char *argv[]) -> void
+{
+	string indexname = argc > 4 ? argv[4] : "";
+
+	ifstream fin(argv[2], std::ios::binary);
+	std::ostringstream contents;
+	contents << fin.rdbuf();
+	string text = contents.str();
+
+	SuffixIndex index;
+	auto start = std::chrono::steady_clock::now();
+	bool loaded = !indexname.empty() && index.load(indexname, text);
+	bool indexed = loaded;
+	if (!loaded)
+	{
+		if (!indexname.empty())
+			std::cerr << "no index of " << argv[2] << " in " << indexname << ", building it\n";
+
+		indexed = index.build(text);
+		if (indexed && !indexname.empty())
+			index.save(indexname);
+		else if (!indexed)
+			std::cerr << argv[2] << " is too long to index, scanning it for each query\n";
+	}
+	std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
+
+	size_t count = 0;
+	start = std::chrono::steady_clock::now();
+	ifstream queries(argv[3]);
+	string query;
+	while (getline(queries, query))
+	{
+		if (!query.empty())
+		{
+			cout << std::boolalpha << (indexed ? index.is_substring(query) : CompiledPattern(query).matches(text)) << "\n";
+			count++;
+		}
+	}
+	std::chrono::duration<double> queried = std::chrono::steady_clock::now() - start;
+
+	std::cerr << (loaded ? "loaded " : "built ") << text.size() << " bytes of text in " << built.count() << " s, index "
+		<< index.bytes() << " bytes, " << count << " queries at " << (count ? queried.count() / count * 1e6 : 0.0) << " us each\n";
+}
+
+// is_substring() for each query, reading the text a chunk at a time. Each query waits on its current segment, and a window carries
+// the end of one chunk over to the next, long enough that no occurrence of any segment is split between chunks
+auto stream_match(std::istream &in, const vector<string> &queries, size_t chunk_size) -> vector<bool>
+{
+	vector<CompiledPattern> patterns;
+	vector<size_t> segment(queries.size(), 0);
+	vector<uint64_t> earliest(queries.size(), 0); // where in the whole text the current segment may start
+	vector<bool> found(queries.size(), false);
+	size_t remaining = 0;
+	size_t overlap = 0;
+
+	for (size_t q = 0; q < queries.size(); ++q)
+	{
+		patterns.emplace_back(queries[q]);
+		for (const auto &part : patterns[q].segments)
+			overlap = std::max(overlap, part.length - 1);
+
+		if (patterns[q].segments.empty())
+			found[q] = true;
+		else
+			remaining++;
+	}
+
+	string window;
+	window.reserve(overlap + chunk_size);
+	uint64_t window_start = 0;
+
+	while (remaining > 0 && in)
+	{
+		size_t kept = window.size();
+		window.resize(kept + chunk_size);
+		in.read(&window[kept], static_cast<std::streamsize>(chunk_size));
+		window.resize(kept + static_cast<size_t>(in.gcount()));
+		if (window.size() == kept)
+			break;
+
+		string_view view(window);
+		for (size_t q = 0; q < queries.size(); ++q)
+		{
+			while (!found[q])
+			{
+				size_t from = earliest[q] > window_start ? static_cast<size_t>(earliest[q] - window_start) : 0;
+				if (from >= view.size())
+					break;
+
+				size_t occurence = patterns[q].find(segment[q], view.substr(from));
+				if (occurence == string::npos)
+					break;
+
+				earliest[q] = window_start + from + occurence + patterns[q].segments[segment[q]].length;
+				if (++segment[q] == patterns[q].segments.size())
+				{
+					found[q] = true;
+					remaining--;
+				}
+			}
+		}
+
+		size_t keep = std::min(overlap, window.size());
+		window_start += window.size() - keep;
+		window.erase(0, window.size() - keep);
+	}
+
+	return found;
+}
+
+// The text is streamed from one file, each line of another being a query of it
+auto stream_queries(const string &textname, const string &queryname) -> void
+{
+	vector<string> queries;
+	ifstream fin(queryname);
+	string query;
+	while (getline(fin, query))
+	{
+		if (!query.empty())
+			queries.push_back(query);
+	}
+
+	ifstream text(textname, std::ios::binary);
+	for (bool found : stream_match(text, queries, stream_chunk_size))
+		cout << std::boolalpha << found << "\n";
+}
+
+// Each line of one file is a rule, a query matched against every line of the other. For each of those lines the 1-based numbers of
+// the rules it matches are written, separated by spaces. The rules are compiled once, however many lines there are
+auto match_rules(const string &rulesname, const string &logname) -> void
+{
+	vector<CompiledPattern> rules;
+	ifstream fin(rulesname);
+	string rule;
+	while (getline(fin, rule))
+	{
+		if (!rule.empty())
+			rules.emplace_back(rule);
+	}
+
+	ifstream log(logname);
+	string line;
+	while (getline(log, line))
+	{
+		const char *separator = "";
+		for (size_t r = 0; r < rules.size(); ++r)
+		{
+			if (rules[r].matches(line))
+			{
+				cout << separator << r + 1;
+				separator = " ";
+			}
+		}
+		cout << "\n";
+	}
+}
+
+// First occurrence of the pattern in the text, or npos, searched for by several threads. The text is cut into blocks, each searched
+// with the end of the next block's pattern length - 1 bytes, and the threads take the blocks in order. Once an occurrence is found
+// no block after it is started, and the earliest occurrence of those found is the first
+size_t parallel_first(const Data &input, unsigned threads, size_t block_size)
+{
+	string_view P = input.pattern;
+	string_view T = input.text;
+	if (P.empty())
+		return 0;
+	if (P.length() > T.length())
+		return string::npos;
+
+	size_t blocks = (T.length() - P.length()) / block_size + 1;
+	Engine engine = choose_engine(P.length());
+
+	std::atomic<size_t> next_block(0);
+	std::atomic<size_t> first(string::npos);
+
+	auto work = [&]()
+	{
+		while (true)
+		{
+			size_t block = next_block.fetch_add(1);
+			size_t start = block * block_size;
+			if (block >= blocks || start >= first.load())
+				return;
+
+			Data data;
+			data.pattern = P;
+			data.text = T.substr(start, block_size + P.length() - 1);
+			size_t found = find_first(data, engine);
+			if (found == string::npos)
+				continue;
+
+			size_t position = start + found;
+			size_t current = first.load();
+			while (position < current && !first.compare_exchange_weak(current, position))
+				;
+		}
+	};
+
+	threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, blocks)));
+	vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; ++t)
+		pool.emplace_back(work);
+	work();
+	for (auto &thread : pool)
+		thread.join();
+
+	return first.load();
+}
+
+// is_substring() with each segment's first occurrence after the one before found by parallel_first()
+auto parallel_is_substring(const string &source, const string &query, unsigned threads, size_t block_size) -> bool
+{
+	Segments segments;
+	tokenise(query, segments);
+
+	string_view text(source);
+	size_t start = 0;
+
+	for (const auto &pattern : segments.parts)
+	{
+		Data data;
+		data.text = text.substr(start);
+		data.pattern = pattern;
+		size_t occurence = parallel_first(data, threads, block_size);
+
+		if (occurence == string::npos)
+			return false;
+
+		start = start + occurence + pattern.length();
+	}
+
+	return true;
+}
+
+// Text of the given length, each character drawn from the alphabet
+auto random_text(std::mt19937 &rng, size_t length, string_view alphabet) -> string
+{
+	string text(length, ' ');
+	for (auto &c : text)
+		c = alphabet[rng() % alphabet.size()];
+	return text;
+}
+
+auto test_is_substring() -> void
+{
+	auto Test = [](bool expected, const string &a, const string &b)
+	{
+		assert(is_substring(a, b) == expected);
+	};
+
+	Test(true, "Hello", "ell");
+	Test(true, "This is good", "is");
+	Test(true, "CodeEval", "C*Eval");
+	Test(false, "CodeEval", "C\\*Eval");
+	Test(true, "Code*Eval", "Code\\*Eval");
+	Test(false, "Old", "Young");
+	Test(true, "the quick brown fox jumps over the lazy dog", "dog"); 
+	Test(true, "the quick brown fox jumps over the lazy dog", "quick*fox");
+	Test(false, "the quick brown fox jumps over the lazy dog", "quick\\*fox");
+	Test(true, "the quick*fox jumps over the lazy dog", "quick\\*fox");
+	Test(true, "123456789987654321", "7*9");
+	Test(true, "123456789987654321", "1*1");
+	Test(true, "123456789987654321", "1*");
+	Test(true, "123456789987654321", "*1");
+	Test(true, "anything whatsoever", "*");
+	Test(false, "anything whatsoever", "\\*");
+	Test(true, "*", "*");
+	Test(true, "*", "\\*");
+	Test(true, "abcdef*ghijkl", "f*g");
+	Test(true, "abcdef*ghijkl", "f\\*g");
+	Test(true, "abcdef*ghijkl", "d*i");
+	Test(false, "the quick brown fox jumps over the lazy dog", "lazy*quick");
+	Test(false, "the quiiiiick brown fox jumps over the laaaaazy dog", "quick*lazy");
+	Test(false, "the quiiiiick brown fox jumps over the laaaaazy dog", "lazy*quick");
+	Test(true, "the quickquickquick brown fox jumps over the lazylazylazy dog", "quick*lazy");
+	Test(true, "quickquickquick brown fox jumps over the lazylazylazy", "quick*lazy");
+	Test(true, "quickquickquicklazylazylazy", "quick*lazy");
+	Test(false, "lazylazylazyquickquickquick", "quick*lazy");
+	Test(false, "slowlazylazylazy", "quick*lazy");
+	Test(false, "quickquickquick123456789", "quick*lazy");
+	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "c*t");
+	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "t*c");
+	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "za");
+	Test(true, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "z*a");
+
+
+	Test(false, "*So*eaE", "*JH*");
+	Test(true, "* So*eaE", "**");
+	Test(true, "blblah*", "blb*h*");
+	Test(false, "blah*", "blb*h*");
+	Test(false, "blah*", "blb*h");
+	Test(true, "CodeEval", "C*Eval");
+	Test(true, "CodeEval", "C*Ev*al");
+	Test(false, "CodeE*val", "C*Ev*al");
+	Test(false, "Old", "*Young*");
+	Test(false, "Old", "*ung*");
 	Test(true, "Old", "*l*");
 	Test(true, "Old", "O*l*");
 	Test(true, "Old", "*d");
@@ -363,3 +1764,497 @@ auto test_split() -> void
 	Test("C**Eval", { "C", "", "Eval" });
 	Test("C***Eval", { "C", "", "", "Eval" });
 }
+
+auto test_tokenise() -> void
+{
+	auto Test = [](const string &query, const vector<string> &expected)
+	{
+		Segments segments;
+		tokenise(query, segments);
+		assert(vector<string>(segments.parts.begin(), segments.parts.end()) == expected);
+	};
+
+	Test("CodeEval", { "CodeEval" });
+	Test("C*Eval", { "C", "Eval" });
+	Test("C\\*Eval", { "C*Eval" });
+	Test("*C**Ev*al*", { "C", "Ev", "al" });
+	Test("\\*", { "*" });
+	Test("*", {});
+	Test("a\\b\\\\*c", { "a\\b\\*c" });
+	Test("a\\", { "a\\" });
+}
+
+auto test_rabin_karp() -> void
+{
+	auto Test = [](const string &text, const string &pattern)
+	{
+		vector<size_t> expected;
+		for (size_t pos = text.find(pattern); pos != string::npos; pos = text.find(pattern, pos + 1))
+			expected.push_back(pos);
+
+		Data data;
+		data.text = text;
+		data.pattern = pattern;
+		assert(rabin_karp(data) == expected);
+		assert(rabin_karp_precomputed(data) == expected);
+	};
+
+	Test("Hello", "ell");
+	Test("Hello", "Hello");
+	Test("Hello", "Hello!");
+	Test("aaaaaa", "aa");
+	Test("abababab", "aba");
+	Test("\xff\xfe\xff\xfe", "\xff\xfe");
+
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 200; ++i)
+	{
+		string text = random_text(rng, rng() % 300, "ab*");
+
+		Test(text, text.substr(rng() % (text.size() + 1), 1 + rng() % 4));
+	}
+}
+
+auto test_match_all() -> void
+{
+	auto Test = [](const string &source, const vector<string> &queries)
+	{
+		vector<bool> expected;
+		for (const auto &query : queries)
+			expected.push_back(is_substring(source, query));
+
+		assert(match_all(source, queries) == expected);
+	};
+
+	Test("CodeEval", { "C*Eval", "C\\*Eval", "Code", "Old", "*", "\\*", "e*e", "E*e*a" });
+	Test("Code*Eval", { "Code\\*Eval", "C*Ev*al", "e\\*E", "*l" });
+	Test("quickquickquicklazylazylazy", { "quick*lazy", "lazy*quick", "quick*quick*quick*quick", "y*y*y", "ka*az" });
+	Test("aaaa", { "aa*aa", "aa*aaa", "a*a*a*a", "a*a*a*a*a", "aaaa", "aaaaa" });
+	Test("", { "a", "*", "" });
+
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 200; ++i)
+	{
+		string source = random_text(rng, rng() % 60, "ab*");
+
+		vector<string> queries(1 + rng() % 20);
+		for (auto &query : queries)
+			query = random_text(rng, 1 + rng() % 8, "ab*\\");
+
+		Test(source, queries);
+	}
+}
+
+auto test_simd_first() -> void
+{
+	auto Test = [](const string &text, const string &pattern)
+	{
+		Data data;
+		data.text = text;
+		data.pattern = pattern;
+		assert(simd_first(data) == text.find(pattern));
+		assert(find_first(data, Engine::RabinKarp) == text.find(pattern));
+		assert(find_first(data, Engine::TwoWay) == text.find(pattern));
+	};
+
+	Test("Hello", "ell");
+	Test("Hello", "o");
+	Test("Hello", "Hello!");
+	Test("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", "za");
+	Test(string(100, 'a') + "b", "ab");
+	Test(string(100, 'a') + "b", "b");
+	Test(string(100, 'a') + "b", string(40, 'a') + "b");
+
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 500; ++i)
+	{
+		string text = random_text(rng, rng() % 200, "ab\xff");
+		string pattern = random_text(rng, 1 + rng() % 6, "ab\xff");
+
+		Test(text, pattern);
+	}
+}
+
+auto test_suffix_index() -> void
+{
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 200; ++i)
+	{
+		string text = random_text(rng, rng() % 300, i % 2 ? "ab" : "ab*\xff");
+
+		SuffixIndex index;
+		index.build(text);
+
+		vector<uint32_t> expected(text.size());
+		for (size_t k = 0; k < expected.size(); ++k)
+			expected[k] = static_cast<uint32_t>(k);
+		std::sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b)
+		{
+			return string_view(text).substr(a) < string_view(text).substr(b);
+		});
+		assert(index.sa == expected);
+
+		for (int q = 0; q < 20; ++q)
+		{
+			string query = random_text(rng, 1 + rng() % 6, "ab*\\");
+
+			assert(index.is_substring(query) == is_substring(text, query));
+
+			string pattern = query.substr(0, 1 + rng() % 3);
+			size_t offset = rng() % (text.size() + 2);
+			assert(index.first_at_or_after(pattern, offset) == (offset > text.size() ? string::npos : text.find(pattern, offset)));
+		}
+	}
+
+	SuffixIndex saved;
+	saved.build("the quick brown fox jumps over the lazy dog");
+	assert(saved.save("test_suffix_index.bin"));
+
+	SuffixIndex loaded;
+	assert(loaded.load("test_suffix_index.bin", saved.text));
+	assert(loaded.text == saved.text && loaded.sa == saved.sa);
+	assert(loaded.is_substring("quick*fox") && !loaded.is_substring("lazy*quick"));
+
+	// an index of some other text, or a damaged one, is rejected
+	assert(!loaded.load("test_suffix_index.bin", "the quick brown fox jumps over the lazy cat"));
+	assert(!loaded.load("test_suffix_index.bin", "the quick brown fox") && loaded.sa.empty());
+
+	string bytes;
+	{
+		ifstream fin("test_suffix_index.bin", std::ios::binary);
+		std::ostringstream contents;
+		contents << fin.rdbuf();
+		bytes = contents.str();
+	}
+	auto Corrupt = [&](string damaged)
+	{
+		std::ofstream fout("test_suffix_index.bin", std::ios::binary);
+		fout.write(damaged.data(), damaged.size());
+		fout.close();
+		assert(!loaded.load("test_suffix_index.bin", saved.text));
+	};
+	Corrupt(bytes.substr(0, bytes.size() - 1));
+	Corrupt(bytes + "x");
+	Corrupt("SUFFIDX0" + bytes.substr(8));
+	string duplicate = bytes;
+	duplicate[duplicate.size() - 4] = duplicate[duplicate.size() - 8];
+	duplicate[duplicate.size() - 3] = duplicate[duplicate.size() - 7];
+	duplicate[duplicate.size() - 2] = duplicate[duplicate.size() - 6];
+	duplicate[duplicate.size() - 1] = duplicate[duplicate.size() - 5];
+	Corrupt(duplicate);
+	string outside = bytes;
+	outside[outside.size() - 1] = '\x7f';
+	Corrupt(outside);
+	std::remove("test_suffix_index.bin");
+}
+
+auto test_stream_match() -> void
+{
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 200; ++i)
+	{
+		string text = random_text(rng, rng() % 100, "ab*");
+
+		vector<string> queries(1 + rng() % 10);
+		vector<bool> expected;
+		for (auto &query : queries)
+		{
+			query = random_text(rng, 1 + rng() % 8, "ab*\\");
+			expected.push_back(is_substring(text, query));
+		}
+
+		for (size_t chunk_size : { 1, 2, 3, 7, 64 })
+		{
+			std::istringstream in(text);
+			assert(stream_match(in, queries, chunk_size) == expected);
+		}
+	}
+}
+
+auto test_parallel_first() -> void
+{
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 200; ++i)
+	{
+		string text = random_text(rng, rng() % 200, "ab*");
+		string query = random_text(rng, 1 + rng() % 8, "ab*\\");
+
+		string pattern = query.substr(0, 1 + rng() % 4);
+		for (unsigned threads : { 1, 2, 5 })
+		{
+			for (size_t block_size : { 1, 3, 16, 1000 })
+			{
+				Data data;
+				data.text = text;
+				data.pattern = pattern;
+				assert(parallel_first(data, threads, block_size) == text.find(pattern));
+				assert(parallel_is_substring(text, query, threads, block_size) == is_substring(text, query));
+			}
+		}
+	}
+}
+
+auto test_compiled_pattern() -> void
+{
+	// each segment found with std::string::find
+	auto Naive = [](const string &text, const string &query)
+	{
+		Segments segments;
+		tokenise(query, segments);
+
+		size_t start = 0;
+		for (const auto &part : segments.parts)
+		{
+			size_t occurence = text.find(string(part), start);
+			if (occurence == string::npos)
+				return false;
+			start = occurence + part.length();
+		}
+		return true;
+	};
+
+	auto Test = [&](const string &text, const string &query)
+	{
+		bool expected = Naive(text, query);
+		assert(CompiledPattern(query).matches(text) == expected);
+		for (Engine engine : { Engine::RabinKarp, Engine::TwoWay, Engine::Simd })
+			assert(CompiledPattern(query, engine).matches(text) == expected);
+	};
+
+	Test("Hello", "ell");
+	Test("Hello", "Hel*o");
+	Test("Hello", "o*H");
+	Test("Hello", "");
+	Test("Hello", "*");
+	Test("He*llo", "e\\*l");
+	Test("aabaabaabaaab", "aabaaab");
+	Test("abababababc", "ababc");
+
+	// one pattern against many texts, copied and moved first
+	CompiledPattern pattern("a*b\\*c");
+	vector<CompiledPattern> patterns(3, pattern);
+	patterns.push_back(std::move(pattern));
+	for (const auto &compiled : patterns)
+	{
+		assert(compiled.matches("xaxxb*cx"));
+		assert(!compiled.matches("xaxxbcx"));
+		assert(!compiled.matches("b*ca"));
+	}
+
+	// two-way on small alphabets, where patterns are often periodic, and on segments long enough to be chosen for it
+	std::mt19937 rng(random_seed);
+	for (int i = 0; i < 2000; ++i)
+	{
+		const char *alphabet = i % 2 ? "ab" : "abc";
+
+		string text = random_text(rng, rng() % 300, alphabet);
+		string query = random_text(rng, 1 + rng() % 12, alphabet);
+		if (rng() % 2 && !text.empty())
+		{
+			size_t from = rng() % text.size();
+			query = text.substr(from, 1 + rng() % 12);
+		}
+
+		Test(text, query);
+
+		Data data;
+		data.text = text;
+		data.pattern = query;
+		assert(find_first(data, Engine::TwoWay) == text.find(query));
+	}
+
+	for (int i = 0; i < 50; ++i)
+	{
+		string text = random_text(rng, 5000, "ab");
+
+		size_t from = rng() % 4000;
+		string query = text.substr(from, simd_threshold + rng() % 200) + "*" + text.substr(from + 10, 3);
+		if (i % 2)
+			query[rng() % simd_threshold] ^= 3;
+
+		assert(choose_engine(simd_threshold) == Engine::TwoWay);
+		Test(text, query);
+	}
+}
+
+// Throughput of the rolling hash against the precomputed table of hashes, over a few megabytes of random text
+auto benchmark_rabin_karp() -> void
+{
+	std::mt19937 rng(random_seed);
+	for (size_t megabytes : { 1, 4, 16 })
+	{
+		string text = random_text(rng, megabytes << 20, letters);
+
+		Data data;
+		data.text = text;
+		data.pattern = text.substr(text.size() - 16);
+
+		auto start = std::chrono::steady_clock::now();
+		auto precomputed = rabin_karp_precomputed(data);
+		std::chrono::duration<double> before = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		auto rolling = rabin_karp(data);
+		std::chrono::duration<double> after = std::chrono::steady_clock::now() - start;
+
+		assert(rolling == precomputed);
+		cout << megabytes << " MB: precomputed " << megabytes / before.count() << " MB/s, rolling " << megabytes / after.count() << " MB/s\n";
+	}
+}
+
+// Hundreds of wildcard queries of one megabyte of text, one at a time and then all together
+auto benchmark_match_all() -> void
+{
+	std::mt19937 rng(random_seed);
+	string source = random_text(rng, 1 << 20, letters);
+
+	for (size_t count : { 10, 100, 500 })
+	{
+		vector<string> queries(count);
+		for (auto &query : queries)
+		{
+			// two segments drawn from the text, and a third usually not there at all
+			size_t at = rng() % (source.size() - 64);
+			query = source.substr(at, 6) + "*" + source.substr(at + 32, 6) + "*" + random_text(rng, 6, letters);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		vector<bool> one_at_a_time;
+		for (const auto &query : queries)
+			one_at_a_time.push_back(is_substring(source, query));
+		std::chrono::duration<double> before = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		vector<bool> together = match_all(source, queries);
+		std::chrono::duration<double> after = std::chrono::steady_clock::now() - start;
+
+		assert(together == one_at_a_time);
+		cout << count << " queries: one at a time " << before.count() << " s, all together " << after.count() << " s\n";
+	}
+}
+
+// Throughput of each engine over 16 MB of text, for pattern lengths from 1 to 256, the pattern being found right at the end
+auto benchmark_engines() -> void
+{
+	std::mt19937 rng(random_seed);
+	string text = random_text(rng, 16 << 20, letters);
+
+	for (size_t length = 1; length <= 256; length *= 2)
+	{
+		// the pattern's first byte is one the text doesn't have otherwise, so every engine scans the whole text
+		string source = text + "#" + text.substr(0, length - 1);
+		string pattern = source.substr(source.size() - length);
+
+		Data data;
+		data.text = source;
+		data.pattern = pattern;
+
+		cout << "length " << length;
+		for (Engine engine : { Engine::RabinKarp, Engine::TwoWay, Engine::Simd })
+		{
+			auto start = std::chrono::steady_clock::now();
+			size_t found = find_first(data, engine);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			assert(found == source.size() - length);
+			cout << (engine == Engine::Simd ? ", simd " : engine == Engine::TwoWay ? ", two-way " : ": rabin-karp ") << 16 / elapsed.count() << " MB/s";
+		}
+		cout << "\n";
+	}
+}
+
+// Build time, size and query latency of the suffix index of random text, against scanning the text for every query
+auto benchmark_suffix_index() -> void
+{
+	std::mt19937 rng(random_seed);
+	for (size_t megabytes : { 1, 4, 16 })
+	{
+		string text = random_text(rng, megabytes << 20, letters);
+
+		vector<string> queries(1000);
+		for (auto &query : queries)
+		{
+			size_t at = rng() % (text.size() - 64);
+			query = text.substr(at, 5) + "*" + text.substr(at + 20, 5) + "*" + text.substr(rng() % (text.size() - 8), 5);
+		}
+
+		SuffixIndex index;
+		auto start = std::chrono::steady_clock::now();
+		index.build(text);
+		std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		vector<bool> indexed;
+		for (const auto &query : queries)
+			indexed.push_back(index.is_substring(query));
+		std::chrono::duration<double> queried = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		vector<bool> scanned;
+		for (const auto &query : queries)
+			scanned.push_back(is_substring(text, query));
+		std::chrono::duration<double> scanning = std::chrono::steady_clock::now() - start;
+
+		assert(indexed == scanned);
+		cout << megabytes << " MB: built in " << built.count() << " s, index " << index.bytes() / double(1 << 20) << " MB, query "
+			<< queried.count() / queries.size() * 1e6 << " us, scanning " << scanning.count() / queries.size() * 1e6 << " us\n";
+	}
+}
+
+// Throughput of a wildcard query of 256 MB of text with one thread up to the number of cores, the last segment being right at the end
+auto benchmark_parallel() -> void
+{
+	std::mt19937 rng(random_seed);
+	string text = random_text(rng, 256 << 20, letters);
+	text += "#needle";
+
+	string query = text.substr(100 << 20, 8) + "*#needle";
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned threads = 1; ; threads = std::min(threads * 2, cores))
+	{
+		auto start = std::chrono::steady_clock::now();
+		bool found = parallel_is_substring(text, query, threads);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		assert(found);
+		cout << threads << " threads: " << text.size() / double(1 << 20) / elapsed.count() << " MB/s\n";
+
+		if (threads == cores)
+			break;
+	}
+}
+
+// A few rules, compiled once, against a million log lines, against calling is_substring() for every rule and line
+auto benchmark_compiled_pattern() -> void
+{
+	std::mt19937 rng(random_seed);
+	vector<string> lines(1000000);
+	for (auto &line : lines)
+		line = random_text(rng, 40 + rng() % 80, letters);
+
+	vector<string> rules = { "abc*xyz", "error*disk\\*full", "q*u*e*r*y", "zz", string(300, 'a') + "*b" };
+	vector<CompiledPattern> compiled(rules.begin(), rules.end());
+
+	auto start = std::chrono::steady_clock::now();
+	size_t once = 0;
+	for (const auto &line : lines)
+	{
+		for (const auto &rule : compiled)
+			once += rule.matches(line);
+	}
+	std::chrono::duration<double> compiling = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	size_t every = 0;
+	for (const auto &line : lines)
+	{
+		for (const auto &rule : rules)
+			every += is_substring(line, rule);
+	}
+	std::chrono::duration<double> parsing = std::chrono::steady_clock::now() - start;
+
+	assert(once == every);
+	cout << lines.size() << " lines, " << rules.size() << " rules: compiled once " << compiling.count() << " s, parsed every time "
+		<< parsing.count() << " s\n";
+}
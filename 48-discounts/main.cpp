@@ -18,6 +18,8 @@
 #include <tuple>
 #include <cctype>
 #include <cassert>
+#include <limits>
+#include <cmath>
 
 
 using std::string;
@@ -25,6 +27,9 @@ using std::vector;
 using std::map;
 using std::tuple;
 
+// Define this to check the assignment result against the exhaustive search of all scenarios. Only feasible for small inputs
+//#define do_exhaustive_check
+
 
 struct NameInfo
 {
@@ -158,8 +163,8 @@ bool intersect(const vector<T> &set1, const vector<T> &set2)
 }
 
 
-// The score given to a customer/product pairing.
-double suitability_score(const NameInfo &customer, const NameInfo &product)
+// The score given to a customer/product pairing, `commonFactor` being whether their letter counts share a factor other than `1`.
+double suitability_score(const NameInfo &customer, const NameInfo &product, bool commonFactor)
 {
 	double ss = 0.0;
 
@@ -168,15 +173,54 @@ double suitability_score(const NameInfo &customer, const NameInfo &product)
 	else
 		ss = 1.0 * customer.consonants();
 
-	auto factors1 = factors(customer.letters());
-	auto factors2 = factors(product.letters());
-
-	if (intersect(factors1, factors2))
+	if (commonFactor)
 		ss *= 1.5;
 
 	return ss;
 }
 
+// Score every customer/product pairing once into a dense row-major matrix, customers down the rows and products across the columns.
+vector<double> score_matrix(const vector<NameInfo> &customers, const vector<NameInfo> &products)
+{
+	size_t rows = customers.size();
+	size_t cols = products.size();
+
+	// many names share a letter count, so the factor sets and whether they intersect are cached per letter count
+	int longest = 0;
+	for (const auto &info : customers)
+		longest = std::max(longest, info.letters());
+	for (const auto &info : products)
+		longest = std::max(longest, info.letters());
+
+	size_t lengths = static_cast<size_t>(longest) + 1;
+	vector<vector<int>> factorSets(lengths);
+	for (size_t n = 0; n < lengths; ++n)
+		factorSets[n] = factors(static_cast<int>(n));
+
+	enum : char { Unknown = -1, Disjoint = 0, Common = 1 };
+	vector<char> commonFactor(lengths * lengths, Unknown);
+
+	vector<double> scores(rows * cols);
+	for (size_t r = 0; r < rows; ++r)
+		{
+		const NameInfo &customer = customers[r];
+		double *row = &scores[r * cols];
+
+		for (size_t c = 0; c < cols; ++c)
+			{
+			const NameInfo &product = products[c];
+
+			char &common = commonFactor[customer.letters() * lengths + product.letters()];
+			if (common == Unknown)
+				common = intersect(factorSets[customer.letters()], factorSets[product.letters()]) ? Common : Disjoint;
+
+			row[c] = suitability_score(customer, product, common == Common);
+			}
+		}
+
+	return scores;
+}
+
 // Get all possible combinations of elements of `smaller` with elements of `larger`.
 vector<Scenario> combinations(const vector<size_t> &smaller, const vector<size_t> &larger, size_t Pairing::*field1, size_t Pairing::*field2)
 {
@@ -205,6 +249,126 @@ vector<Scenario> combinations(const vector<size_t> &smaller, const vector<size_t
 }
 
 
+// Kuhn-Munkres (Hungarian) algorithm over a row-major `rows` x `cols` matrix of scores, where rows <= cols.
+// Returns for each row the column assigned to it, such that the total score is maximised. O(rows² * cols).
+vector<size_t> hungarian(const vector<double> &scores, size_t rows, size_t cols)
+{
+	assert(rows <= cols);
+	assert(scores.size() == rows * cols);
+
+	const double inf = std::numeric_limits<double>::infinity();
+
+	// potentials for rows and columns, and for each column the (one-based) row matched to it. Index zero is a sentinel.
+	vector<double> u(rows + 1, 0.0);
+	vector<double> v(cols + 1, 0.0);
+	vector<size_t> match(cols + 1, 0);
+	vector<size_t> way(cols + 1, 0);
+	vector<double> minv(cols + 1);
+	vector<char> used(cols + 1);
+
+	for (size_t i = 1; i <= rows; ++i)
+		{
+		// grow an alternating path from row `i` until it reaches a free column
+		match[0] = i;
+		size_t j0 = 0;
+		std::fill(minv.begin(), minv.end(), inf);
+		std::fill(used.begin(), used.end(), false);
+
+		do
+			{
+			used[j0] = true;
+			size_t i0 = match[j0];
+			size_t j1 = 0;
+			double delta = inf;
+
+			const double *row = &scores[(i0 - 1) * cols];
+			for (size_t j = 1; j <= cols; ++j)
+				{
+				if (!used[j])
+					{
+					// maximising score is minimising its negation
+					double cur = -row[j - 1] - u[i0] - v[j];
+					if (cur < minv[j])
+						{
+						minv[j] = cur;
+						way[j] = j0;
+						}
+					if (minv[j] < delta)
+						{
+						delta = minv[j];
+						j1 = j;
+						}
+					}
+				}
+
+			for (size_t j = 0; j <= cols; ++j)
+				{
+				if (used[j])
+					{
+					u[match[j]] += delta;
+					v[j] -= delta;
+					}
+				else
+					{
+					minv[j] -= delta;
+					}
+				}
+
+			j0 = j1;
+			}
+		while (match[j0] != 0);
+
+		// flip the matching along the augmenting path
+		do
+			{
+			size_t j1 = way[j0];
+			match[j0] = match[j1];
+			j0 = j1;
+			}
+		while (j0 != 0);
+		}
+
+	vector<size_t> assignment(rows);
+	for (size_t j = 1; j <= cols; ++j)
+		{
+		if (match[j] != 0)
+			assignment[match[j] - 1] = j - 1;
+		}
+
+	return assignment;
+}
+
+
+// The greatest total score of any assignment over a row-major `rows` x `cols` score matrix, either dimension being larger.
+double maximum_total(const vector<double> &scores, size_t rows, size_t cols)
+{
+	if (rows == 0 || cols == 0)
+		return 0.0;
+
+	// the algorithm wants no more rows than columns, so work on the transpose if need be
+	const vector<double> *matrix = &scores;
+	vector<double> transposed;
+	if (rows > cols)
+		{
+		transposed.resize(scores.size());
+		for (size_t r = 0; r < rows; ++r)
+			for (size_t c = 0; c < cols; ++c)
+				transposed[c * rows + r] = scores[r * cols + c];
+
+		matrix = &transposed;
+		std::swap(rows, cols);
+		}
+
+	vector<size_t> assignment = hungarian(*matrix, rows, cols);
+
+	double total = 0.0;
+	for (size_t r = 0; r < rows; ++r)
+		total += (*matrix)[r * cols + assignment[r]];
+
+	return total;
+}
+
+
 // This brings it all together. For one test `input` get the maximised total suitability score.
 double compute(const string &input)
 {
@@ -213,15 +377,28 @@ double compute(const string &input)
 	vector<string> customerNames = split(discounts.at(0), ',');
 	vector<string> productNames = split(discounts.at(1), ',');
 
-	// get the letters, vowels and consonants of all names
-	vector<NameInfo> nameInfo = name_info(customerNames);
-	vector<NameInfo> productInfo = name_info(productNames);
-	nameInfo.insert(nameInfo.end(), productInfo.begin(), productInfo.end());
-	std::sort(nameInfo.begin(), nameInfo.end());
+	// get the letters, vowels and consonants of all names, and from those the score of every pairing
+	vector<double> scores = score_matrix(name_info(customerNames), name_info(productNames));
+
+	// the best scenario is the solution to the assignment problem on the score matrix
+	return maximum_total(scores, customerNames.size(), productNames.size());
+}
+
+
+#if defined do_exhaustive_check
+// For one test `input` get the maximised total suitability score by trying every possible scenario. O(n!)
+double compute_exhaustive(const string &input)
+{
+	// tokenise the test data
+	vector<string> discounts = split(input, ';');
+	vector<string> customerNames = split(discounts.at(0), ',');
+	vector<string> productNames = split(discounts.at(1), ',');
 
 	size_t numCustomers = customerNames.size();
 	size_t numProducts = productNames.size();
 
+	vector<double> scores = score_matrix(name_info(customerNames), name_info(productNames));
+
 	// get arrays of zero-based indexes into `customerNames` and `productNames`
 	vector<size_t> customers(numCustomers);
 	vector<size_t> products(numProducts);
@@ -237,20 +414,14 @@ double compute(const string &input)
 	else
 		scenarios = combinations(products, customers, &Pairing::product, &Pairing::customer);
 
-	int x = 1;
-	// calculate the suitability of each pair, and the total score for each scenario
+	// look up the suitability of each pair, and the total score for each scenario
 	for (Scenario &sc : scenarios)
 		{
 		sc.total = 0.0;
 
 		for (Pairing &p : sc.candidates)
 			{
-			const auto &itr1 = std::lower_bound(nameInfo.begin(), nameInfo.end(), NameInfo(customerNames.at(p.customer)));
-			const auto &itr2 = std::lower_bound(nameInfo.begin(), nameInfo.end(), NameInfo(productNames.at(p.product)));
-			assert(itr1 != nameInfo.end());
-			assert(itr2 != nameInfo.end());
-
-			p.score = suitability_score(*itr1, *itr2);
+			p.score = scores[p.customer * numProducts + p.product];
 			sc.total += p.score;
 			}
 		}
@@ -262,6 +433,7 @@ double compute(const string &input)
 		});
 	return scenarios.begin()->total;
 }
+#endif
 
 
 int main(int argc, char* argv[])
@@ -285,6 +457,12 @@ int main(int argc, char* argv[])
 					double score = compute(line);
 					std::cout.precision(2);
 					std::cout << std::fixed << score << "\n";
+
+#if defined do_exhaustive_check
+					double expected = compute_exhaustive(line);
+					if (std::abs(score - expected) > 1e-9)
+						std::cerr << "Mismatch: " << score << " expected " << expected << "\n";
+#endif
 					}
 				}
 			}
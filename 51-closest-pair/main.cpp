@@ -8,8 +8,30 @@
 #include <iomanip>
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <cstdint>
+#include <array>
+#include <charconv>
+#include <system_error>
+#include <thread>
+#include <numeric>
 //#include <cfenv>
 
+#if defined __AVX2__ || defined __SSE2__
+#include <immintrin.h>
+#endif
+
+// Define this to time the closest pair engines on random points instead
+//#define do_benchmark
+
+#if defined do_benchmark
+#include <chrono>
+#include <sstream>
+#endif
+
 using std::begin;
 using std::end;
 
@@ -54,7 +76,37 @@ void subtract_smallest(CoordinateVector &coordinates)
 		}
 }
 
-double process(const CoordinateVector &coordinates)
+// Sets with fewer points than this are faster compared pair by pair than divided and conquered
+const size_t brute_force_threshold = 96;
+
+// Sets with fewer points than this are faster compared pair by pair, several pairs at a time, than divided and conquered
+#if defined __AVX2__
+const size_t simd_threshold = 768;
+#elif defined __SSE2__
+const size_t simd_threshold = 512;
+#else
+const size_t simd_threshold = brute_force_threshold;
+#endif
+
+// Coordinates no larger than this in magnitude are exact as doubles, and so are the differences between them
+const long long int exact_coordinate = 1LL << 52;
+
+// Divided sets this small are finished pair by pair
+const size_t divide_cutoff = 8;
+
+// Divided sets with fewer points than this are left to one thread, as are merges of fewer
+const size_t parallel_cutoff = 1 << 16;
+
+// Bytes read from the input at a time by CoordinateReader
+const size_t reader_buffer_size = 1 << 20;
+
+// The order in which grid_hashing() inserts the points is shuffled with this, so that runs are reproducible
+const uint64_t grid_seed = 51;
+
+// The random points of the benchmarks are drawn with this seed, so that their runs are reproducible too
+const uint64_t benchmark_seed = 51;
+
+double brute_force(const CoordinateVector &coordinates)
 {
 	double shortest_distance = std::numeric_limits<double>::max();
 
@@ -83,6 +135,760 @@ double process(const CoordinateVector &coordinates)
 	return std::sqrt(shortest_distance);
 }
 
+// Structure of arrays of the coordinates as doubles, so that consecutive points are loaded into one register
+struct CoordinateArrays
+{
+	std::vector<double> x;
+	std::vector<double> y;
+};
+
+// False if a coordinate is too large for the differences between doubles to be those between the integers, when the arrays are not
+// filled
+bool to_arrays(const CoordinateVector &coordinates, CoordinateArrays &arrays)
+{
+	for (const Coordinate &c : coordinates)
+		{
+		if (std::llabs(c.first) > exact_coordinate || std::llabs(c.second) > exact_coordinate)
+			return false;
+		}
+
+	arrays.x.resize(coordinates.size());
+	arrays.y.resize(coordinates.size());
+	for (size_t i = 0; i < coordinates.size(); ++i)
+		{
+		arrays.x[i] = static_cast<double>(coordinates[i].first);
+		arrays.y[i] = static_cast<double>(coordinates[i].second);
+		}
+
+	return true;
+}
+
+// The same distance as brute_force(), comparing each point with a block of the points after it at a time. The shortest squared
+// distances are kept in two registers, so that each minimum need not wait on the one before, and are reduced across their lanes only
+// once all the pairs have been compared
+double simd_brute_force(const CoordinateArrays &points)
+{
+	const size_t n = points.x.size();
+	const double *x = points.x.data();
+	const double *y = points.y.data();
+	double shortest = std::numeric_limits<double>::max();
+
+#if defined __AVX2__
+	__m256d shortest4 = _mm256_set1_pd(shortest);
+	__m256d other4 = shortest4;
+#elif defined __SSE2__
+	__m128d shortest2 = _mm_set1_pd(shortest);
+	__m128d other2 = shortest2;
+#endif
+
+	for (size_t i = 0; i < n; ++i)
+		{
+		size_t j = i + 1;
+
+#if defined __AVX2__
+		__m256d xi = _mm256_set1_pd(x[i]);
+		__m256d yi = _mm256_set1_pd(y[i]);
+		for (; j + 8 <= n; j += 8)
+			{
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+			__m256d dx2 = _mm256_sub_pd(_mm256_loadu_pd(x + j + 4), xi);
+			__m256d dy2 = _mm256_sub_pd(_mm256_loadu_pd(y + j + 4), yi);
+			shortest4 = _mm256_min_pd(shortest4, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+			other4 = _mm256_min_pd(other4, _mm256_add_pd(_mm256_mul_pd(dx2, dx2), _mm256_mul_pd(dy2, dy2)));
+			}
+		for (; j + 4 <= n; j += 4)
+			{
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+			shortest4 = _mm256_min_pd(shortest4, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+			}
+#elif defined __SSE2__
+		__m128d xi = _mm_set1_pd(x[i]);
+		__m128d yi = _mm_set1_pd(y[i]);
+		for (; j + 4 <= n; j += 4)
+			{
+			__m128d dx = _mm_sub_pd(_mm_loadu_pd(x + j), xi);
+			__m128d dy = _mm_sub_pd(_mm_loadu_pd(y + j), yi);
+			__m128d dx2 = _mm_sub_pd(_mm_loadu_pd(x + j + 2), xi);
+			__m128d dy2 = _mm_sub_pd(_mm_loadu_pd(y + j + 2), yi);
+			shortest2 = _mm_min_pd(shortest2, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+			other2 = _mm_min_pd(other2, _mm_add_pd(_mm_mul_pd(dx2, dx2), _mm_mul_pd(dy2, dy2)));
+			}
+		for (; j + 2 <= n; j += 2)
+			{
+			__m128d dx = _mm_sub_pd(_mm_loadu_pd(x + j), xi);
+			__m128d dy = _mm_sub_pd(_mm_loadu_pd(y + j), yi);
+			shortest2 = _mm_min_pd(shortest2, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+			}
+#endif
+
+		for (; j < n; ++j)
+			{
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			shortest = std::min(shortest, dx * dx + dy * dy);
+			}
+		}
+
+#if defined __AVX2__
+	alignas(32) double lanes[4];
+	_mm256_store_pd(lanes, _mm256_min_pd(shortest4, other4));
+	for (double lane : lanes)
+		shortest = std::min(shortest, lane);
+#elif defined __SSE2__
+	alignas(16) double lanes[2];
+	_mm_store_pd(lanes, _mm_min_pd(shortest2, other2));
+	for (double lane : lanes)
+		shortest = std::min(shortest, lane);
+#endif
+
+	return std::sqrt(shortest);
+}
+
+bool by_y(const Coordinate &a, const Coordinate &b)
+{
+	return a.second < b.second;
+}
+
+double strip_squared(const Coordinate *points, size_t n, long long int middle, Coordinate *buffer, double shortest);
+
+// Smallest squared distance between the points, which are sorted by x and on return are sorted by y instead. Each half is merged
+// into the buffer, from where the points close enough to the dividing line are compared with those just below them.
+// The same squared_distance() as brute_force() is taken of the same pair, and pruning only skips pairs at least as far apart as the
+// shortest so far, so the result is exactly the same
+double closest_squared(Coordinate *points, size_t n, Coordinate *buffer)
+{
+	double shortest = std::numeric_limits<double>::max();
+
+	if (n <= divide_cutoff)
+		{
+		for (size_t i = 0; i < n; ++i)
+			for (size_t j = i + 1; j < n; ++j)
+				shortest = std::min(shortest, squared_distance(points[i], points[j]));
+
+		std::sort(points, points + n, by_y);
+		return shortest;
+		}
+
+	size_t half = n / 2;
+	long long int middle = points[half].first;
+
+	shortest = std::min(closest_squared(points, half, buffer), closest_squared(points + half, n - half, buffer));
+
+	std::merge(points, points + half, points + half, points + n, buffer, by_y);
+	std::copy(buffer, buffer + n, points);
+
+	return strip_squared(points, n, middle, buffer, shortest);
+}
+
+// Smallest squared distance across the dividing line, or shortest if none is shorter, of points sorted by y. The strip either side of
+// the line is gathered in order of y in the buffer, each point compared with those below it until they're too far below
+double strip_squared(const Coordinate *points, size_t n, long long int middle, Coordinate *buffer, double shortest)
+{
+	size_t strip = 0;
+	for (size_t i = 0; i < n; ++i)
+		{
+		double dx = static_cast<double>(points[i].first - middle);
+		if (dx * dx >= shortest)
+			continue;
+
+		for (size_t j = strip; j-- > 0; )
+			{
+			double dy = static_cast<double>(points[i].second - buffer[j].second);
+			if (dy * dy >= shortest)
+				break;
+
+			shortest = std::min(shortest, squared_distance(points[i], buffer[j]));
+			}
+
+		buffer[strip++] = points[i];
+		}
+
+	return shortest;
+}
+
+// The same distance as brute_force() in O(n log n)
+double divide_and_conquer(const CoordinateVector &coordinates)
+{
+	CoordinateVector points(coordinates);
+	CoordinateVector buffer(points.size());
+	std::sort(begin(points), end(points));
+
+	return std::sqrt(closest_squared(points.data(), points.size(), buffer.data()));
+}
+
+// Merge of the two sorted ranges into out by several threads. The middle of the longer range splits the shorter where it would go,
+// and the two pairs of halves either side are merged by separate threads into either side of where the middle goes
+template<typename Less>
+void parallel_merge(const Coordinate *a, size_t na, const Coordinate *b, size_t nb, Coordinate *out, Less less, unsigned threads)
+{
+	if (threads < 2 || na + nb < parallel_cutoff)
+		{
+		std::merge(a, a + na, b, b + nb, out, less);
+		return;
+		}
+
+	// ties go to the first range, as std::merge has them
+	size_t ma = 0;
+	size_t mb = 0;
+	if (na >= nb)
+		{
+		ma = na / 2;
+		mb = static_cast<size_t>(std::lower_bound(b, b + nb, a[ma], less) - b);
+		}
+	else
+		{
+		mb = nb / 2;
+		ma = static_cast<size_t>(std::upper_bound(a, a + na, b[mb], less) - a);
+		}
+
+	std::thread worker([=]()
+		{
+		parallel_merge(a, ma, b, mb, out, less, threads / 2);
+		});
+	parallel_merge(a + ma, na - ma, b + mb, nb - mb, out + ma + mb, less, threads - threads / 2);
+	worker.join();
+}
+
+// Work on [first, last) of n items for each of at most threads parts, each part by a thread of its own and numbered from 0
+template<typename Work>
+void parallel_parts(size_t n, unsigned threads, Work work)
+{
+	std::vector<std::thread> workers;
+	size_t part = (n + threads - 1) / threads;
+	for (size_t first = 0; first < n; first += part)
+		workers.emplace_back([=]()
+			{
+			work(first / part, first, std::min(n, first + part));
+			});
+
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+void parallel_copy(const Coordinate *from, size_t n, Coordinate *to, unsigned threads)
+{
+	parallel_parts(n, threads, [=](size_t, size_t first, size_t last)
+		{
+		std::copy(from + first, from + last, to + first);
+		});
+}
+
+// strip_squared() by several threads. Each gathers the strip points of its part of the points, in order of y, into the buffer after
+// those of the parts before it, and then compares its part of the strip with the points below. The strip is that of the shortest
+// distance of the halves, not narrowed as closer pairs are found, which only means comparing pairs strip_squared() might skip
+double parallel_strip_squared(const Coordinate *points, size_t n, long long int middle, Coordinate *buffer, double shortest,
+	unsigned threads)
+{
+	if (threads < 2 || n < parallel_cutoff)
+		return strip_squared(points, n, middle, buffer, shortest);
+
+	auto in_strip = [=](const Coordinate &c)
+		{
+		double dx = static_cast<double>(c.first - middle);
+		return dx * dx < shortest;
+		};
+
+	std::vector<size_t> starts(threads + 1, 0);
+	parallel_parts(n, threads, [&](size_t t, size_t first, size_t last)
+		{
+		starts[t + 1] = static_cast<size_t>(std::count_if(points + first, points + last, in_strip));
+		});
+	std::partial_sum(begin(starts), end(starts), begin(starts));
+
+	parallel_parts(n, threads, [&](size_t t, size_t first, size_t last)
+		{
+		std::copy_if(points + first, points + last, buffer + starts[t], in_strip);
+		});
+
+	std::vector<double> found(threads, shortest);
+	parallel_parts(starts[threads], threads, [&](size_t t, size_t first, size_t last)
+		{
+		double nearest = shortest;
+		for (size_t i = first; i < last; ++i)
+			for (size_t j = i; j-- > 0; )
+				{
+				double dy = static_cast<double>(buffer[i].second - buffer[j].second);
+				if (dy * dy >= nearest)
+					break;
+
+				nearest = std::min(nearest, squared_distance(buffer[i], buffer[j]));
+				}
+
+		found[t] = nearest;
+		});
+
+	return *std::min_element(begin(found), end(found));
+}
+
+// Sort of the points by x, the halves sorted by separate threads and merged by them into the buffer
+void parallel_sort(Coordinate *points, size_t n, Coordinate *buffer, unsigned threads)
+{
+	if (threads < 2 || n < parallel_cutoff)
+		{
+		std::sort(points, points + n);
+		return;
+		}
+
+	size_t half = n / 2;
+	std::thread worker([=]()
+		{
+		parallel_sort(points, half, buffer, threads / 2);
+		});
+	parallel_sort(points + half, n - half, buffer + half, threads - threads / 2);
+	worker.join();
+
+	parallel_merge(points, half, points + half, n - half, buffer, std::less<Coordinate>(), threads);
+	parallel_copy(buffer, n, points, threads);
+}
+
+// closest_squared() with the halves taken by separate threads, each half of the threads in turn dividing its half, until the sets
+// are too small to be worth it. Each half has its own half of the buffer, and the halves are merged by y and the strip between them
+// searched by all of the threads
+double parallel_closest_squared(Coordinate *points, size_t n, Coordinate *buffer, unsigned threads)
+{
+	if (threads < 2 || n < parallel_cutoff)
+		return closest_squared(points, n, buffer);
+
+	size_t half = n / 2;
+	long long int middle = points[half].first;
+
+	double left = 0;
+	std::thread worker([&]()
+		{
+		left = parallel_closest_squared(points, half, buffer, threads / 2);
+		});
+	double right = parallel_closest_squared(points + half, n - half, buffer + half, threads - threads / 2);
+	worker.join();
+
+	parallel_merge(points, half, points + half, n - half, buffer, by_y, threads);
+	parallel_copy(buffer, n, points, threads);
+
+	return parallel_strip_squared(points, n, middle, buffer, std::min(left, right), threads);
+}
+
+// The same distance as divide_and_conquer(), and so as brute_force(), found by several threads
+double parallel_divide_and_conquer(const CoordinateVector &coordinates, unsigned threads)
+{
+	CoordinateVector points(coordinates);
+	CoordinateVector buffer(points.size());
+	parallel_sort(points.data(), points.size(), buffer.data(), threads);
+
+	return std::sqrt(parallel_closest_squared(points.data(), points.size(), buffer.data(), threads));
+}
+
+// Points bucketed by the square cell of a grid they fall in, the cells found by an open addressing hash of their coordinates. The
+// points of a cell are chained through their indices, most recently inserted first. Cell coordinates are truncated quotients, so the
+// cells either side of zero are twice as wide as the rest, which only means they hold more points
+class CellGrid
+{
+public:
+	static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+	explicit CellGrid(size_t capacity)
+	{
+		size_t slots = 16;
+		while (slots < 2 * capacity)
+			slots *= 2;
+
+		mask = slots - 1;
+		cells.resize(slots);
+		next.resize(capacity, none);
+	}
+
+	// The number of points the grid was built for
+	size_t capacity() const
+	{
+		return next.size();
+	}
+
+	long long int width() const
+	{
+		return side;
+	}
+
+	// Empty the grid and set its cells to be this wide. Only the slots holding cells are cleared, so that emptying the grid costs
+	// as much as filling it did rather than its whole capacity
+	void reset(long long int width)
+	{
+		side = width;
+		for (size_t slot : occupied)
+			cells[slot].head = none;
+		occupied.clear();
+	}
+
+	void insert(const CoordinateVector &points, size_t index)
+	{
+		Cell &c = find(points[index].first / side, points[index].second / side);
+		if (c.head == none)
+			occupied.push_back(static_cast<size_t>(&c - cells.data()));
+
+		next[index] = c.head;
+		c.head = index;
+	}
+
+	// Smallest squared distance from the point to those in its own cell and the eight around it, or shortest if none is closer
+	double nearest(const CoordinateVector &points, const Coordinate &point, double shortest)
+	{
+		long long int x = point.first / side;
+		long long int y = point.second / side;
+
+		for (long long int cx = x - 1; cx <= x + 1; ++cx)
+			for (long long int cy = y - 1; cy <= y + 1; ++cy)
+				for (size_t i = find(cx, cy).head; i != none; i = next[i])
+					shortest = std::min(shortest, squared_distance(point, points[i]));
+
+		return shortest;
+	}
+
+private:
+	struct Cell
+	{
+		long long int x = 0;
+		long long int y = 0;
+		size_t head = none;
+	};
+
+	// The cell with these coordinates, or the empty slot where it would go
+	Cell &find(long long int x, long long int y)
+	{
+		uint64_t hash = static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ull ^ static_cast<uint64_t>(y) * 0xc2b2ae3d27d4eb4full;
+		size_t slot = static_cast<size_t>(hash ^ (hash >> 29)) & mask;
+
+		while (cells[slot].head != none && (cells[slot].x != x || cells[slot].y != y))
+			slot = (slot + 1) & mask;
+
+		Cell &c = cells[slot];
+		if (c.head == none)
+			{
+			c.x = x;
+			c.y = y;
+			}
+		return c;
+	}
+
+	long long int side = 1;
+	size_t mask = 0;
+	std::vector<Cell> cells;
+	std::vector<size_t> occupied;
+	std::vector<size_t> next;
+};
+
+// Width of grid cell such that two points closer than the square root of shortest are in the same or neighbouring cells
+long long int cell_width(double shortest)
+{
+	double width = std::ceil(std::sqrt(shortest)) + 1;
+	if (width >= static_cast<double>(std::numeric_limits<long long int>::max() / 2))
+		return std::numeric_limits<long long int>::max() / 2;
+	return static_cast<long long int>(width);
+}
+
+// The same distance as brute_force() in expected O(n), the points being inserted in random order into a grid of cells as wide as
+// the shortest distance so far. Only the nine cells around each point can hold one closer, and the grid is rebuilt whenever one is,
+// which for the i-th point happens with probability at most 2/i
+double grid_hashing(const CoordinateVector &coordinates)
+{
+	size_t n = coordinates.size();
+	if (n < 2)
+		return std::sqrt(std::numeric_limits<double>::max());
+
+	CoordinateVector points(coordinates);
+	std::mt19937_64 rng(grid_seed);
+	std::shuffle(begin(points), end(points), rng);
+
+	double shortest = squared_distance(points[0], points[1]);
+	CellGrid grid(n);
+	grid.reset(cell_width(shortest));
+	grid.insert(points, 0);
+	grid.insert(points, 1);
+
+	// nothing is closer than a repeated point
+	for (size_t i = 2; i < n && shortest > 0; ++i)
+		{
+		double nearest = grid.nearest(points, points[i], shortest);
+		if (nearest < shortest)
+			{
+			shortest = nearest;
+			grid.reset(cell_width(shortest));
+			for (size_t j = 0; j <= i; ++j)
+				grid.insert(points, j);
+			}
+		else
+			grid.insert(points, i);
+		}
+
+	return std::sqrt(shortest);
+}
+
+// The closest pair of a set of points that grows by a batch at a time. The points are kept in a grid of cells at least as wide as
+// the shortest distance, which is only rebuilt when that distance falls to less than half the width of a cell, or when the grid is
+// full, doubling its capacity. Otherwise each point of a batch is compared with the few in the nine cells around it
+class ClosestPairStream
+{
+public:
+	ClosestPairStream()
+		: grid(0), rng(grid_seed)
+	{
+	}
+
+	// Points within a batch are inserted in random order, so that the shortest distance is expected to shrink only a few times
+	void insert(const CoordinateVector &batch)
+	{
+		size_t first = points.size();
+		points.insert(end(points), begin(batch), end(batch));
+
+		// nothing is closer than a repeated point, so once there is one the grid is left as it is
+		if (shortest == 0)
+			return;
+
+		std::shuffle(begin(points) + first, end(points), rng);
+
+		if (points.size() > grid.capacity())
+			rebuild(first, std::max(2 * grid.capacity(), points.size()));
+
+		for (size_t i = first; i < points.size() && shortest > 0; ++i)
+			{
+			double nearest = grid.nearest(points, points[i], shortest);
+			if (nearest < shortest)
+				{
+				shortest = nearest;
+				if (shortest > 0 && 2 * cell_width(shortest) <= grid.width())
+					rebuild(i, grid.capacity());
+				}
+
+			grid.insert(points, i);
+			}
+	}
+
+	// The same distance as process() of all the points inserted so far
+	double current() const
+	{
+		return std::sqrt(shortest);
+	}
+
+	size_t size() const
+	{
+		return points.size();
+	}
+
+private:
+	// A grid of the given capacity holding the first count points, with cells as wide as the shortest distance
+	void rebuild(size_t count, size_t capacity)
+	{
+		if (capacity != grid.capacity())
+			grid = CellGrid(capacity);
+
+		grid.reset(cell_width(shortest));
+		for (size_t i = 0; i < count; ++i)
+			grid.insert(points, i);
+	}
+
+	CoordinateVector points;
+	CellGrid grid;
+	double shortest = std::numeric_limits<double>::max();
+	std::mt19937_64 rng;
+};
+
+double process(const CoordinateVector &coordinates)
+{
+	CoordinateArrays arrays;
+	if (coordinates.size() < simd_threshold && to_arrays(coordinates, arrays))
+		return simd_brute_force(arrays);
+	else if (coordinates.size() < brute_force_threshold)
+		return brute_force(coordinates);
+
+	unsigned threads = std::thread::hardware_concurrency();
+	if (threads > 1 && coordinates.size() >= 2 * parallel_cutoff)
+		return parallel_divide_and_conquer(coordinates, threads);
+	else
+		return divide_and_conquer(coordinates);
+}
+
+// A k-d tree over points of D coordinates, stored implicitly: the subtree over [begin, end) of the nodes holds its median along the
+// splitting axis in the middle, the points below it before and those above after. The axis cycles with depth, so nothing is
+// stored beyond the points, each with its index in the set it was built from. Built once, it answers any number of queries
+template<size_t D>
+class KdTree
+{
+public:
+	using Point = std::array<double, D>;
+
+	static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+	// A point found by a query, with its squared distance from the query
+	struct Neighbour
+	{
+		double distance = 0;
+		size_t index = 0;
+
+		friend bool operator<(const Neighbour &l, const Neighbour &r)
+		{
+			return l.distance < r.distance || (l.distance == r.distance && l.index < r.index);
+		}
+	};
+
+	explicit KdTree(const std::vector<Point> &points)
+	{
+		nodes.resize(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+			nodes[i] = Node{ points[i], i };
+
+		build(0, nodes.size(), 0);
+	}
+
+	size_t size() const
+	{
+		return nodes.size();
+	}
+
+	// The k points nearest the query, nearest first, leaving out the point with index exclude
+	void nearest(const Point &query, size_t k, std::vector<Neighbour> &found, size_t exclude = none) const
+	{
+		found.clear();
+		if (k > 0)
+			search(0, nodes.size(), 0, query, k, exclude, found);
+
+		std::sort_heap(begin(found), end(found));
+	}
+
+	// The points no further from the query than radius, nearest first
+	void within(const Point &query, double radius, std::vector<Neighbour> &found) const
+	{
+		found.clear();
+		search(0, nodes.size(), 0, query, radius * radius, found);
+
+		std::sort(begin(found), end(found));
+	}
+
+	std::vector<std::vector<Neighbour>> nearest(const std::vector<Point> &queries, size_t k) const
+	{
+		std::vector<std::vector<Neighbour>> found(queries.size());
+		for (size_t q = 0; q < queries.size(); ++q)
+			nearest(queries[q], k, found[q]);
+
+		return found;
+	}
+
+	std::vector<std::vector<Neighbour>> within(const std::vector<Point> &queries, double radius) const
+	{
+		std::vector<std::vector<Neighbour>> found(queries.size());
+		for (size_t q = 0; q < queries.size(); ++q)
+			within(queries[q], radius, found[q]);
+
+		return found;
+	}
+
+	// The k nearest other points to each point, by the point's index, queried in the order the tree holds them so that consecutive
+	// queries visit much the same nodes
+	std::vector<std::vector<Neighbour>> all_nearest(size_t k = 1) const
+	{
+		std::vector<std::vector<Neighbour>> found(nodes.size());
+		for (const Node &node : nodes)
+			nearest(node.point, k, found[node.index], node.index);
+
+		return found;
+	}
+
+private:
+	struct Node
+	{
+		Point point;
+		size_t index;
+	};
+
+	static double squared_distance(const Point &a, const Point &b)
+	{
+		double distance = 0;
+		for (size_t d = 0; d < D; ++d)
+			distance += (a[d] - b[d]) * (a[d] - b[d]);
+
+		return distance;
+	}
+
+	void build(size_t first, size_t last, size_t depth)
+	{
+		if (last - first < 2)
+			return;
+
+		size_t axis = depth % D;
+		size_t middle = first + (last - first) / 2;
+		std::nth_element(begin(nodes) + first, begin(nodes) + middle, begin(nodes) + last, [axis](const Node &a, const Node &b)
+			{
+			return a.point[axis] < b.point[axis];
+			});
+
+		build(first, middle, depth + 1);
+		build(middle + 1, last, depth + 1);
+	}
+
+	// found is a max heap of the nearest k so far, so that the furthest of them is at the front
+	void search(size_t first, size_t last, size_t depth, const Point &query, size_t k, size_t exclude, std::vector<Neighbour> &found) const
+	{
+		if (first >= last)
+			return;
+
+		size_t middle = first + (last - first) / 2;
+		const Node &node = nodes[middle];
+
+		if (node.index != exclude)
+			{
+			Neighbour candidate{ squared_distance(node.point, query), node.index };
+			if (found.size() < k)
+				{
+				found.push_back(candidate);
+				std::push_heap(begin(found), end(found));
+				}
+			else if (candidate < found.front())
+				{
+				std::pop_heap(begin(found), end(found));
+				found.back() = candidate;
+				std::push_heap(begin(found), end(found));
+				}
+			}
+
+		// the side of the splitting plane the query is on first, then the other if it's nearer than the furthest found so far
+		double offset = query[depth % D] - node.point[depth % D];
+		bool below = offset < 0;
+		search(below ? first : middle + 1, below ? middle : last, depth + 1, query, k, exclude, found);
+		if (found.size() < k || offset * offset <= found.front().distance)
+			search(below ? middle + 1 : first, below ? last : middle, depth + 1, query, k, exclude, found);
+	}
+
+	void search(size_t first, size_t last, size_t depth, const Point &query, double radius2, std::vector<Neighbour> &found) const
+	{
+		if (first >= last)
+			return;
+
+		size_t middle = first + (last - first) / 2;
+		const Node &node = nodes[middle];
+
+		double distance = squared_distance(node.point, query);
+		if (distance <= radius2)
+			found.push_back(Neighbour{ distance, node.index });
+
+		double offset = query[depth % D] - node.point[depth % D];
+		if (offset <= 0 || offset * offset <= radius2)
+			search(first, middle, depth + 1, query, radius2, found);
+		if (offset >= 0 || offset * offset <= radius2)
+			search(middle + 1, last, depth + 1, query, radius2, found);
+	}
+
+	std::vector<Node> nodes;
+};
+
+// The coordinates as points of a two dimensional k-d tree
+std::vector<KdTree<2>::Point> to_points(const CoordinateVector &coordinates)
+{
+	std::vector<KdTree<2>::Point> points(coordinates.size());
+	for (size_t i = 0; i < coordinates.size(); ++i)
+		points[i] = { { static_cast<double>(coordinates[i].first), static_cast<double>(coordinates[i].second) } };
+
+	return points;
+}
+
+#if defined do_benchmark
+// The line by line parser that CoordinateReader replaced, kept to compare it with
 Coordinate parse_coord(const std::string &text)
 {
 	auto num_spaces = std::count_if(begin(text), end(text), [](char c)
@@ -112,7 +918,7 @@ bool is_number(const std::string &s)
 		}) == s.end();
 }
 
-bool read_next_set(std::ifstream &fin, CoordinateVector &coords)
+bool read_next_set(std::istream &fin, CoordinateVector &coords)
 {
 	if (fin.good())
 		{
@@ -169,27 +975,415 @@ bool read_next_set(std::ifstream &fin, CoordinateVector &coords)
 		}
 }
 
+#endif
+
+// Whitespace separated integers parsed with std::from_chars straight out of a large buffer, refilled from the stream as it empties,
+// so that no line or number is copied into a string of its own
+class CoordinateReader
+{
+public:
+	explicit CoordinateReader(std::istream &in, size_t buffer_size = reader_buffer_size)
+		: in(in), buffer(std::max<size_t>(buffer_size, 1))
+	{
+	}
+
+	// False at the end of the input, or if what's next isn't a number
+	bool read(long long int &value)
+	{
+		while (true)
+			{
+			while (position < filled && is_space(buffer[position]))
+				position++;
+
+			if (position < filled || exhausted)
+				break;
+
+			refill();
+			}
+
+		// the buffer is refilled, and grown if the number fills it, until the number ends within it, so that it can't be cut in two
+		size_t end = position;
+		while (true)
+			{
+			while (end < filled && !is_space(buffer[end]))
+				end++;
+
+			if (end < filled || exhausted)
+				break;
+
+			end -= position;
+			if (end == buffer.size())
+				buffer.resize(2 * buffer.size());
+			refill();
+			}
+
+		auto result = std::from_chars(buffer.data() + position, buffer.data() + end, value);
+		if (result.ec != std::errc() || result.ptr != buffer.data() + end)
+			return false;
+
+		position = end;
+		return true;
+	}
+
+	// The next set, its number of points and then their coordinates, into the coordinates, whose storage is reused from one set
+	// to the next. False at the end of the input, the set of no points or a set cut short
+	bool read_set(CoordinateVector &coordinates)
+	{
+		long long int n = 0;
+		if (!read(n) || n <= 0)
+			return false;
+
+		coordinates.resize(static_cast<size_t>(n));
+		for (Coordinate &c : coordinates)
+			{
+			if (!read(c.first) || !read(c.second))
+				return false;
+			}
+
+		return true;
+	}
+
+private:
+	static bool is_space(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+	}
+
+	// The unread bytes are moved to the start of the buffer and the rest of it filled from the stream
+	void refill()
+	{
+		std::copy(buffer.data() + position, buffer.data() + filled, buffer.data());
+		filled -= position;
+		position = 0;
+
+		in.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+		filled += static_cast<size_t>(in.gcount());
+		exhausted = !in;
+	}
+
+	std::istream &in;
+	std::vector<char> buffer;
+	size_t position = 0;
+	size_t filled = 0;
+	bool exhausted = false;
+};
+
+void print_distance(double distance)
+{
+	if (distance < 10000.f)
+		std::cout << std::fixed << std::setprecision(4) << distance << "\n";
+	else
+		std::cout << "INFINITY\n";
+}
+
+// Each set of the file is a batch of points added to those before, the closest pair of all of them written after each
+void stream_batches(const char *filename)
+{
+	std::ifstream fin(filename, std::ios::binary);
+	CoordinateReader reader(fin);
+	CoordinateVector batch;
+	ClosestPairStream stream;
+
+	while (fin.is_open() && reader.read_set(batch))
+		{
+		stream.insert(batch);
+		print_distance(stream.current());
+		}
+}
+
+// For each point of each set, its k nearest other points: their 1-based positions in the set and distances, nearest first. A blank
+// line follows each set
+void nearest_neighbours(size_t k, const char *filename)
+{
+	std::ifstream fin(filename, std::ios::binary);
+	CoordinateReader reader(fin);
+	CoordinateVector coordinates;
+
+	while (fin.is_open() && reader.read_set(coordinates))
+		{
+		KdTree<2> tree(to_points(coordinates));
+		auto found = tree.all_nearest(k);
+
+		for (size_t i = 0; i < found.size(); ++i)
+			{
+			std::cout << i + 1 << ":";
+			for (const auto &neighbour : found[i])
+				std::cout << " " << neighbour.index + 1 << " " << std::fixed << std::setprecision(4) << std::sqrt(neighbour.distance);
+			std::cout << "\n";
+			}
+		std::cout << "\n";
+		}
+}
+
+#if defined do_benchmark
+// n points with coordinates from low to high, x drawn before y
+CoordinateVector random_coordinates(size_t n, std::mt19937_64 &rng, long long int low = 0, long long int high = 1000000000)
+{
+	std::uniform_int_distribution<long long int> coordinate(low, high);
+
+	CoordinateVector coordinates(n);
+	for (Coordinate &c : coordinates)
+		{
+		c.first = coordinate(rng);
+		c.second = coordinate(rng);
+		}
+
+	return coordinates;
+}
+
+// Seconds taken per set by the engine, over sets of n random points totalling about a million points
+template<typename Engine>
+double time_per_set(Engine engine, size_t n, std::mt19937_64 &rng, double &distance)
+{
+	size_t sets = std::max<size_t>(1, (1 << 20) / n);
+	std::vector<CoordinateVector> coordinates;
+	for (size_t k = 0; k < sets; ++k)
+		coordinates.push_back(random_coordinates(n, rng));
+
+	auto start = std::chrono::steady_clock::now();
+	distance = 0;
+	for (const CoordinateVector &c : coordinates)
+		distance += engine(c);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count() / sets;
+}
+
+// Brute force against divide and conquer for sets of increasing size, to find where one overtakes the other
+void benchmark_crossover()
+{
+	std::mt19937_64 rng(benchmark_seed);
+
+	for (size_t n = 4; n <= 8192; n *= 2)
+		{
+		std::mt19937_64 same(rng);
+		double brute = 0;
+		double divided = 0;
+		double brute_time = time_per_set(brute_force, n, rng, brute);
+		double divided_time = time_per_set(divide_and_conquer, n, same, divided);
+
+		assert(brute == divided);
+		std::cout << n << " points: brute force " << brute_time * 1e6 << " us, divide and conquer " << divided_time * 1e6 << " us\n";
+		}
+}
+
+// Grid hashing against process() for sets of 100 to ten million points
+void benchmark_grid_hashing()
+{
+	std::mt19937_64 rng(benchmark_seed);
+
+	for (size_t n = 100; n <= 10000000; n *= 10)
+		{
+		std::mt19937_64 same(rng);
+		double processed = 0;
+		double hashed = 0;
+		double process_time = time_per_set(process, n, rng, processed);
+		double grid_time = time_per_set(grid_hashing, n, same, hashed);
+
+		assert(processed == hashed);
+		std::cout << n << " points: process " << process_time * 1e3 << " ms, grid hashing " << grid_time * 1e3 << " ms\n";
+		}
+}
+
+// Brute force several pairs at a time against divide and conquer for sets of increasing size, to find where one overtakes the other
+void benchmark_simd()
+{
+	std::mt19937_64 rng(benchmark_seed);
+	auto simd = [](const CoordinateVector &coordinates)
+		{
+		CoordinateArrays arrays;
+		to_arrays(coordinates, arrays);
+		return simd_brute_force(arrays);
+		};
+
+	for (size_t n = 64; n <= 8192; n *= 2)
+		{
+		std::mt19937_64 same(rng);
+		double vectorised = 0;
+		double divided = 0;
+		double simd_time = time_per_set(simd, n, rng, vectorised);
+		double divided_time = time_per_set(divide_and_conquer, n, same, divided);
+
+		assert(vectorised == divided);
+		std::cout << n << " points: simd brute force " << simd_time * 1e6 << " us, divide and conquer " << divided_time * 1e6 << " us\n";
+		}
+}
+
+// Building a k-d tree and finding every point's nearest neighbour with it, the nearest of those being the closest pair
+void benchmark_kd_tree()
+{
+	std::mt19937_64 rng(benchmark_seed);
+
+	for (size_t n = 1000; n <= 1000000; n *= 10)
+		{
+		CoordinateVector coordinates = random_coordinates(n, rng);
+
+		auto start = std::chrono::steady_clock::now();
+		KdTree<2> tree(to_points(coordinates));
+		std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		auto found = tree.all_nearest();
+		std::chrono::duration<double> queried = std::chrono::steady_clock::now() - start;
+
+		double shortest = std::numeric_limits<double>::max();
+		for (const auto &neighbours : found)
+			shortest = std::min(shortest, neighbours.front().distance);
+
+		assert(std::sqrt(shortest) == process(coordinates));
+		std::cout << n << " points: built in " << built.count() * 1e3 << " ms, all nearest neighbours in " << queried.count() * 1e3 << " ms\n";
+		}
+}
+
+// A million points streamed in batches of a thousand, the time taken by each batch against the time taken by process() to start
+// from scratch
+void benchmark_stream()
+{
+	std::mt19937_64 rng(benchmark_seed);
+	CoordinateVector all = random_coordinates(1000000, rng);
+	ClosestPairStream stream;
+
+	const size_t batch_size = 1000;
+	double slowest = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t first = 0; first < all.size(); first += batch_size)
+		{
+		auto batch_start = std::chrono::steady_clock::now();
+		stream.insert(CoordinateVector(begin(all) + first, begin(all) + first + batch_size));
+		std::chrono::duration<double> batch = std::chrono::steady_clock::now() - batch_start;
+		slowest = std::max(slowest, batch.count());
+		}
+	std::chrono::duration<double> streamed = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	double distance = process(all);
+	std::chrono::duration<double> processed = std::chrono::steady_clock::now() - start;
+
+	assert(stream.current() == distance);
+	std::cout << all.size() / batch_size << " batches of " << batch_size << ": " << streamed.count() / (all.size() / batch_size) * 1e3
+		<< " ms each, slowest " << slowest * 1e3 << " ms, process() of all " << processed.count() * 1e3 << " ms\n";
+}
+
+// Throughput of the reader against the line by line parser, over a million points in sets of a thousand, then of the reader alone
+// with the numbers separated by runs of whitespace
+void benchmark_parsing()
+{
+	std::mt19937_64 rng(benchmark_seed);
+
+	std::string text;
+	std::string spaced;
+	for (size_t set = 0; set < 1000; ++set)
+		{
+		text += "1000\n";
+		spaced += "  1000 \r\n";
+		for (const Coordinate &c : random_coordinates(1000, rng, -1000000000, 1000000000))
+			{
+			std::string x = std::to_string(c.first);
+			std::string y = std::to_string(c.second);
+			text += x + " " + y + "\n";
+			spaced += "\t" + x + "   " + y + " \r\n";
+			}
+		}
+	text += "0\n";
+	spaced += "0\n";
+
+	auto megabytes_per_second = [](const std::string &input, auto parse)
+		{
+		std::istringstream in(input);
+		CoordinateVector coordinates;
+		long long int total = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		total = parse(in, coordinates);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		return std::make_pair(input.size() / double(1 << 20) / elapsed.count(), total);
+		};
+
+	auto lines = megabytes_per_second(text, [](std::istream &in, CoordinateVector &coordinates)
+		{
+		long long int total = 0;
+		while (read_next_set(in, coordinates))
+			total += coordinates.back().first;
+		return total;
+		});
+	auto reader = [](std::istream &in, CoordinateVector &coordinates)
+		{
+		CoordinateReader reader(in);
+		long long int total = 0;
+		while (reader.read_set(coordinates))
+			total += coordinates.back().first;
+		return total;
+		};
+	auto buffered = megabytes_per_second(text, reader);
+	auto whitespace = megabytes_per_second(spaced, reader);
+
+	assert(lines.second == buffered.second && buffered.second == whitespace.second);
+	std::cout << "line by line " << lines.first << " MB/s, reader " << buffered.first << " MB/s, reader with extra whitespace "
+		<< whitespace.first << " MB/s\n";
+}
+
+// Ten million points with one thread up to the number of cores, against divide and conquer with one
+void benchmark_parallel()
+{
+	std::mt19937_64 rng(benchmark_seed);
+	CoordinateVector coordinates = random_coordinates(10000000, rng);
+
+	auto start = std::chrono::steady_clock::now();
+	double expected = divide_and_conquer(coordinates);
+	std::chrono::duration<double> sequential = std::chrono::steady_clock::now() - start;
+	std::cout << "divide and conquer " << sequential.count() * 1e3 << " ms\n";
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads = 1; ; threads = std::min(threads * 2, cores))
+		{
+		start = std::chrono::steady_clock::now();
+		double distance = parallel_divide_and_conquer(coordinates, threads);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		assert(distance == expected);
+		std::cout << threads << " threads: " << elapsed.count() * 1e3 << " ms, speedup " << sequential.count() / elapsed.count() << "\n";
+
+		if (threads == cores)
+			break;
+		}
+}
+#endif
+
 int main(int argc, char *argv[])
 {
-	if (argc > 1)
+#if defined do_benchmark
+	benchmark_crossover();
+	benchmark_grid_hashing();
+	benchmark_simd();
+	benchmark_kd_tree();
+	benchmark_stream();
+	benchmark_parsing();
+	benchmark_parallel();
+	return 0;
+#endif
+
+	// the k nearest neighbours of every point: main --knn k file
+	if (argc > 3 && std::string(argv[1]) == "--knn")
+		nearest_neighbours(std::stoul(argv[2]), argv[3]);
+	// each set a batch of points added to those before: main --stream file
+	else if (argc > 2 && std::string(argv[1]) == "--stream")
+		stream_batches(argv[2]);
+	else if (argc > 1)
 		{
 		std::string filename(argv[1]);
-		std::ifstream fin(filename.c_str());
+		std::ifstream fin(filename.c_str(), std::ios::binary);
 
 		if (fin.is_open())
 			{
+			CoordinateReader reader(fin);
 			CoordinateVector coordinates;
 
-			while (read_next_set(fin, coordinates))
+			while (reader.read_set(coordinates))
 				{
 				subtract_smallest(coordinates);
 
-				double distance = process(coordinates);
-
-				if (distance < 10000.f)
-					std::cout << std::fixed << std::setprecision(4) << distance << "\n";
-				else
-					std::cout << "INFINITY\n";
+				print_distance(process(coordinates));
 				}
 			}
 		}
@@ -5,18 +5,22 @@
 #include <fstream>
 #include <sstream>
 #include <cassert>
-
-class Tree;
-class Node;
-using DataType = char;
+#include <algorithm>
+#include <cstdint>
+#include <cctype>
 
 //#define UNIT_TESTS
 
-auto BreadthFirstInsertion(Tree &tree, const std::string &value) -> void;
-auto DepthFirstPrint(const Tree &tree, std::ostream &os) -> void;
+auto PrintWords(const std::string &number, std::ostream &os) -> void;
 auto Split(const std::string &value, char delimiter) -> std::vector<std::string>;
+auto TrimLineEnd(std::string &line) -> void;
+
+class Trie;
+auto LoadDictionary(const std::string &filename, Trie &trie) -> void;
+auto PrintDictionaryWords(const Trie &trie, const std::string &number, std::ostream &os) -> void;
 
-static bool start = true;
+// Words are gathered in a buffer this big before being written out
+const size_t outputBufferSize = 1 << 16;
 
 const std::array<std::vector<char>, 10> telephone =
 {
@@ -34,118 +38,214 @@ const std::array<std::vector<char>, 10> telephone =
 	}
 };
 
-class Node
+// The words of a dictionary, a node to each prefix. The nodes are held in one vector and refer to their first child and next
+// sibling by index, the siblings in alphabetical order
+class Trie
 {
-	Node *m_firstChild = nullptr;
-	Node *m_nextSibling = nullptr;
-	DataType m_data;
-
 public:
-	Node(const DataType &data = 0)
-		: m_data(data)
-	{}
+	static const uint32_t none = UINT32_MAX;
 
-	~Node()
+	struct Node
 	{
-		if (m_nextSibling)
-		{
-			delete m_nextSibling;
-		}
-		if (m_firstChild)
-		{
-			delete m_firstChild;
-		}
-	}
+		char letter = 0;
+		bool word = false;
+		uint32_t firstChild = none;
+		uint32_t nextSibling = none;
+	};
 
-	Node *AddChild(const DataType &data)
-	{
-		Node *node = new Node(data);
+private:
+	std::vector<Node> m_nodes;
 
-		if (m_firstChild)
+public:
+	Trie()
+		: m_nodes(1)
+	{}
+
+	void Insert(const std::string &word)
+	{
+		uint32_t node = 0;
+		for (char letter : word)
 		{
-			Node *child = m_firstChild;
-			while (child->m_nextSibling)
+			// the first child not before the letter, and the link to it, where the letter's node goes if it isn't there
+			uint32_t *link = &m_nodes[node].firstChild;
+			while (*link != none && m_nodes[*link].letter < letter)
 			{
-				child = child->m_nextSibling;
+				link = &m_nodes[*link].nextSibling;
 			}
-			child->m_nextSibling = node;
-		}
-		else
-		{
-			m_firstChild = node;
-		}
 
-		return node;
-	}
-
-	void Print(std::ostream &os, const std::string &prefix = "")
-	{
-		if (m_firstChild == nullptr)
-		{
-			if (start)
+			if (*link == none || m_nodes[*link].letter != letter)
 			{
-				os << (prefix.c_str() + 1) << m_data;
-				start = false;
+				Node child;
+				child.letter = letter;
+				child.nextSibling = *link;
+
+				// linked before the push, which may move the nodes and with them the link
+				uint32_t index = static_cast<uint32_t>(m_nodes.size());
+				*link = index;
+				m_nodes.push_back(child);
+				node = index;
 			}
 			else
 			{
-				os << prefix << m_data;
+				node = *link;
 			}
 		}
 
-		Node *node = m_firstChild;
-		while (node)
-		{
-			node->Print(os, prefix + m_data);
-			node = node->m_nextSibling;
-		}
+		m_nodes[node].word = true;
 	}
 
-	void Assign(std::vector<std::string> &v, const std::string &prefix = "")
+	const Node &GetNode(uint32_t index) const
 	{
-		if (m_firstChild == nullptr)
-			v.push_back(prefix + m_data);
+		return m_nodes[index];
+	}
 
-		Node *node = m_firstChild;
-		while (node)
-		{
-			node->Assign(v, prefix + m_data);
-			node = node->m_nextSibling;
-		}
+	uint32_t GetRoot() const
+	{
+		return 0;
 	}
 
-	Node *GetSibling()
+	size_t Size() const
 	{
-		return m_nextSibling;
+		return m_nodes.size();
 	}
 };
 
-class Tree
+// The dictionary words, and sequences of them, that a number spells. The trie is walked along with the digits, only following
+// letters on the key of the next digit, and at the end of a word starts again from the root for the next word. A split is only
+// taken where the rest of the number can be spelt by whole words, which is worked out for every position first
+class DictionaryWalk
 {
-	Node *m_root = nullptr;
+	const Trie &m_trie;
+	const std::string &m_number;
+	std::ostream &m_os;
+	std::array<char, 256> m_keys;
+	std::vector<bool> m_spellable;
+	std::string m_phrase;
+	bool m_first = true;
 
 public:
-	Tree()
+	DictionaryWalk(const Trie &trie, const std::string &number, std::ostream &os)
+		: m_trie(trie), m_number(number), m_os(os), m_spellable(number.size() + 1, false)
 	{
-		m_root = new Node(',');
-		start = true;
+		// the digit each letter is on, from the keypad
+		m_keys.fill(0);
+		for (size_t digit = 0; digit < telephone.size(); ++digit)
+		{
+			for (char letter : telephone[digit])
+			{
+				m_keys[static_cast<unsigned char>(letter)] = static_cast<char>('0' + digit);
+			}
+		}
+
+		FindSpellable();
+	}
+
+	void Print()
+	{
+		if (!m_number.empty() && m_spellable[0])
+			Walk(0, m_trie.GetRoot());
 	}
 
-	~Tree()
+private:
+	bool OnKey(char letter, size_t position) const
 	{
-		delete m_root;
+		return m_keys[static_cast<unsigned char>(letter)] == m_number[position];
 	}
 
-	Node *GetRoot() const
+	// Whether the number from each position on is a sequence of whole words, working back from the end. From each position the
+	// nodes the digits lead to are followed together, until one is a word with a spellable position after it
+	void FindSpellable()
 	{
-		return m_root;
+		const size_t length = m_number.size();
+		m_spellable[length] = true;
+
+		std::vector<uint32_t> frontier;
+		std::vector<uint32_t> next;
+		for (size_t start = length; start-- > 0; )
+		{
+			frontier.assign(1, m_trie.GetRoot());
+			for (size_t position = start; position < length && !frontier.empty() && !m_spellable[start]; ++position)
+			{
+				next.clear();
+				for (uint32_t node : frontier)
+				{
+					for (uint32_t child = m_trie.GetNode(node).firstChild; child != Trie::none; child = m_trie.GetNode(child).nextSibling)
+					{
+						if (!OnKey(m_trie.GetNode(child).letter, position))
+							continue;
+
+						next.push_back(child);
+						if (m_trie.GetNode(child).word && m_spellable[position + 1])
+							m_spellable[start] = true;
+					}
+				}
+				frontier.swap(next);
+			}
+		}
+	}
+
+	void Walk(size_t position, uint32_t node)
+	{
+		for (uint32_t index = m_trie.GetNode(node).firstChild; index != Trie::none; index = m_trie.GetNode(index).nextSibling)
+		{
+			const Trie::Node &child = m_trie.GetNode(index);
+			if (!OnKey(child.letter, position))
+				continue;
+
+			m_phrase.push_back(child.letter);
+
+			if (child.word && m_spellable[position + 1])
+			{
+				if (position + 1 == m_number.size())
+				{
+					Emit();
+				}
+				else
+				{
+					m_phrase.push_back(' ');
+					Walk(position + 1, m_trie.GetRoot());
+					m_phrase.pop_back();
+				}
+			}
+
+			if (position + 1 < m_number.size())
+				Walk(position + 1, index);
+
+			m_phrase.pop_back();
+		}
+	}
+
+	void Emit()
+	{
+		if (!m_first)
+			m_os << ',';
+		m_first = false;
+
+		m_os << m_phrase;
 	}
 };
 
 // the main function
 int main(int argc, char *argv[])
 {
-	if (argc > 1)
+	// only the dictionary words each number spells: main --words dictionary numbers
+	if (argc > 3 && std::string(argv[1]) == "--words")
+	{
+		Trie trie;
+		LoadDictionary(argv[2], trie);
+
+		std::ifstream fin(argv[3]);
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			TrimLineEnd(line);
+			if (line.empty())
+				continue;
+
+			PrintDictionaryWords(trie, line, std::cout);
+		}
+	}
+	else if (argc > 1)
 	{
 		std::string filename(argv[1]);
 		std::ifstream fin(filename.c_str());
@@ -155,72 +255,183 @@ int main(int argc, char *argv[])
 			while (fin.good())
 			{
 				std::getline(fin, line);
+				TrimLineEnd(line);
 				if (line.empty())
 					continue;
 
-				Tree tree;
-				BreadthFirstInsertion(tree, line);
-
-				DepthFirstPrint(tree, std::cout);
+				PrintWords(line, std::cout);
 			}
 			fin.close();
 		}
 	}
 	else
 	{
-		Tree tree;
-		BreadthFirstInsertion(tree, "0000000"); //4155230
-
-		DepthFirstPrint(tree, std::cout);
+		PrintWords("0000000", std::cout); //4155230
 	}
 	return 0;
 }
 
-void BreadthFirstInsertion(Tree &tree, const std::string &line)
+// Every word the number spells, in order, separated by commas. The letters are turned like the wheels of an odometer, each wheel
+// having as many letters as its digit on the keypad and the last turning fastest. Each word is the one buffer as it stands
+void GenerateWords(const std::string &number, std::ostream &os)
 {
-	std::vector<Node *> level0;
-	std::vector<Node *> level1;
+	const size_t length = number.size();
+	if (length == 0)
+		return;
 
-	Node *root = tree.GetRoot();
-	level0.push_back(root);
+	std::vector<const std::vector<char> *> wheels(length);
+	std::vector<size_t> positions(length, 0);
+	std::string word(length, ' ');
 
-	for (char c : line)
+	for (size_t i = 0; i < length; ++i)
 	{
-		int key = std::atoi(&c);
+		char c = number[i];
+		wheels[i] = &telephone[c >= '0' && c <= '9' ? c - '0' : 0];
+		word[i] = wheels[i]->front();
+	}
 
-		const std::vector<char> &digits = telephone[key];
+	std::array<char, outputBufferSize> buffer;
+	size_t used = 0;
+	bool first = true;
 
-		for (Node *parent : level0)
+	while (true)
+	{
+		if (used + length + 1 > buffer.size())
 		{
-			for (auto i = std::begin(digits); i != std::end(digits); ++i)
+			os.write(buffer.data(), used);
+			used = 0;
+		}
+
+		if (!first)
+			buffer[used++] = ',';
+		first = false;
+
+		if (length >= buffer.size())
+		{
+			os.write(buffer.data(), used);
+			os.write(word.data(), length);
+			used = 0;
+		}
+		else
+		{
+			std::copy(word.begin(), word.end(), buffer.begin() + used);
+			used += length;
+		}
+
+		// turn the last wheel, and each wheel before it that comes back round
+		size_t i = length;
+		while (i > 0)
+		{
+			--i;
+			if (++positions[i] < wheels[i]->size())
 			{
-				Node *child = parent->AddChild(*i);
+				word[i] = (*wheels[i])[positions[i]];
+				break;
+			}
 
-				level1.push_back(child);
+			positions[i] = 0;
+			word[i] = wheels[i]->front();
+			if (i == 0)
+			{
+				os.write(buffer.data(), used);
+				return;
 			}
 		}
 
-		level0 = level1;
-		level1.clear();
 	}
 }
 
-void DepthFirstPrint(const Tree &tree, std::ostream &os)
+void PrintWords(const std::string &number, std::ostream &os)
 {
 #if defined UNIT_TESTS
 	std::stringstream ss;
-	tree.GetRoot()->Print(ss);
+	GenerateWords(number, ss);
 
 	const std::string str = ss.str();
 	std::vector<std::string> words = Split(str, ',');
 
+	// anything other than a digit is on key 0, as GenerateWords() has it
+	size_t count = 1;
+	for (char c : number)
+		count *= telephone[c >= '0' && c <= '9' ? c - '0' : 0].size();
+
 	assert(!str.empty());
 	assert(str.at(0) != ',');
 	assert(str.back() != ',');
-	assert(std::all_of(std::begin(words), std::end(words), [](const std::string &s) {return s.length() == 7; }));
+	assert(words.size() == count);
+	assert(std::all_of(std::begin(words), std::end(words), [&](const std::string &s) {return s.length() == number.length(); }));
 	assert(std::is_sorted(std::begin(words), std::end(words)));
 #else
-	tree.GetRoot()->Print(os);
+	GenerateWords(number, os);
+	os << "\n";
+#endif
+}
+
+// The carriage return left at the end of a line of a file written with Windows line endings
+void TrimLineEnd(std::string &line)
+{
+	if (!line.empty() && line.back() == '\r')
+		line.pop_back();
+}
+
+// One word to a line, in any case. Words with anything other than letters on the keypad are left out
+void LoadDictionary(const std::string &filename, Trie &trie)
+{
+	std::ifstream fin(filename.c_str());
+	std::string word;
+	while (std::getline(fin, word))
+	{
+		TrimLineEnd(word);
+		for (char &c : word)
+		{
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+		}
+
+		if (!word.empty() && std::all_of(word.begin(), word.end(), [](char c) {return c >= 'a' && c <= 'z'; }))
+			trie.Insert(word);
+	}
+}
+
+// The words and sequences of words, separated by spaces, that the number spells, separated by commas
+void PrintDictionaryWords(const Trie &trie, const std::string &number, std::ostream &os)
+{
+#if defined UNIT_TESTS
+	std::stringstream ss;
+	DictionaryWalk(trie, number, ss).Print();
+
+	// every phrase spells the number, and every one of its words is in the dictionary
+	const std::string str = ss.str();
+	for (const std::string &phrase : Split(str, ','))
+	{
+		if (str.empty())
+			break;
+
+		std::string digits;
+		for (const std::string &word : Split(phrase, ' '))
+		{
+			uint32_t node = trie.GetRoot();
+			for (char letter : word)
+			{
+				node = trie.GetNode(node).firstChild;
+				while (node != Trie::none && trie.GetNode(node).letter != letter)
+				{
+					node = trie.GetNode(node).nextSibling;
+				}
+				assert(node != Trie::none);
+
+				size_t key = 0;
+				while (std::find(telephone[key].begin(), telephone[key].end(), letter) == telephone[key].end())
+				{
+					key++;
+				}
+				digits += static_cast<char>('0' + key);
+			}
+			assert(trie.GetNode(node).word);
+		}
+		assert(digits == number);
+	}
+#else
+	DictionaryWalk(trie, number, os).Print();
 	os << "\n";
 #endif
 }
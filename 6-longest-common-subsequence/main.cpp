@@ -4,22 +4,103 @@
 #include <algorithm>
 #include <fstream>
 #include <cassert>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <bitset>
+
+#if defined __AVX2__
+#include <immintrin.h>
+#endif
 
 using std::string;
 using std::vector;
 using std::cout;
 using std::ifstream;
 
+// Define this to check the bit-parallel length against the length of the reconstructed lcs
+//#define do_length_check
+
+// Define this to check the linear space lcs against the one reconstructed from the table
+//#define do_linear_check
+
+// Define this to run the wavefront fill benchmark instead. Input lengths may be given on the command-line
+//#define do_benchmark
+
+#if defined do_benchmark
+#include <chrono>
+#include <random>
+#endif
+
+// Tables needing more bytes than this are not built, the same lcs instead being found in linear space
+constexpr size_t table_memory_budget = size_t(256) << 20;
+
+// Per-character bitmasks of the positions at which each character occurs in a string, 64 positions to a word
+struct MatchMasks
+{
+	size_t length = 0;
+	size_t words = 0;
+	vector<uint64_t> bits; // 256 rows of `words` words each
+
+	explicit MatchMasks(const string &str);
+
+	const uint64_t *operator[](unsigned char c) const { return &bits[c * words]; }
+};
+
+// The dynamic programming table, one contiguous buffer in row-major order
+struct Table
+{
+	size_t rows = 0;
+	size_t cols = 0;
+	vector<int> cells;
+
+	Table(size_t rows, size_t cols) : rows(rows), cols(cols), cells(rows * cols, 0) {}
+
+	int *operator[](size_t r) { return &cells[r * cols]; }
+	const int *operator[](size_t r) const { return &cells[r * cols]; }
+};
+
+// Cells along each side of the square tiles the table is filled in
+constexpr size_t tile_size = 256;
+
 auto split(const string &value, char delimiter) -> vector<string>;
-auto lcs(string &str1, string &str2) -> string;
-auto table(string &str1, string &str2) -> vector<vector<int>>;
-auto reconstruct(const vector<vector<int>> &d, const string &a, const string &b) -> string;
-auto print(vector<vector<int>> distances) -> void;
+auto lcs(string &str1, string &str2, size_t budget = table_memory_budget) -> string;
+auto lcs_linear(const string &str1, const string &str2) -> string;
+auto lcs_linear(const MatchMasks &masks, const string &reference, const string &candidate) -> string;
+auto batch(ifstream &fin) -> void;
+auto lcs_length(const string &str1, const string &str2) -> size_t;
+auto lcs_length(const MatchMasks &masks, const string &other) -> size_t;
+auto table(const string &str1, const string &str2, unsigned threads = std::thread::hardware_concurrency()) -> Table;
+auto reconstruct(const Table &d, const string &a, const string &b) -> string;
+auto print(const Table &distances) -> void;
+#if defined do_benchmark
+auto benchmark(const vector<size_t> &lengths) -> void;
+#endif
 
 
 int main(int argc, char *argv[])
 {
-	if (argc > 1)
+#if defined do_benchmark
+	vector<size_t> lengths;
+	for (int i = 1; i < argc; ++i)
+		lengths.push_back(std::stoul(argv[i]));
+	if (lengths.empty())
+		lengths = { 10000, 20000, 50000, 100000, 200000 };
+	benchmark(lengths);
+	return 0;
+#endif
+
+	// one against many: the first line of the file is the reference string, each line after it a candidate to compare with it
+	if (argc > 2 && string(argv[1]) == "--batch")
+		{
+		string filename(argv[2]);
+		ifstream fin(filename.c_str());
+
+		if (fin.is_open())
+			batch(fin);
+		}
+	else if (argc > 1)
 		{
 		string filename(argv[1]);
 		ifstream fin(filename.c_str());
@@ -37,6 +118,19 @@ int main(int argc, char *argv[])
 					auto str1 = tokens[0];
 					auto str2 = tokens[1];
 					cout << lcs(str1, str2) << '\n';
+
+#if defined do_linear_check
+					auto linear = lcs_linear(str1, str2);
+					if (linear != lcs(str1, str2))
+						std::cerr << "Mismatch: " << linear << " expected " << lcs(str1, str2) << '\n';
+#endif
+
+#if defined do_length_check
+					auto expected = lcs(str1, str2).size();
+					auto actual = lcs_length(str1, str2);
+					if (actual != expected)
+						std::cerr << "Mismatch: " << actual << " expected " << expected << '\n';
+#endif
 					}
 				}
 			}
@@ -45,6 +139,33 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+// the lcs of a reference string with each of a stream of candidates, the reference's match masks being built just once
+auto batch(ifstream &fin) -> void
+{
+	string reference;
+	getline(fin, reference);
+	MatchMasks masks(reference);
+
+	string candidate;
+	while (fin.good())
+		{
+		getline(fin, candidate);
+
+		if (!candidate.empty())
+			{
+			cout << lcs_linear(masks, reference, candidate) << '\n';
+
+#if defined do_linear_check
+			auto expected = lcs(reference, candidate);
+			if (lcs_linear(masks, reference, candidate) != expected)
+				std::cerr << "Mismatch: " << lcs_linear(masks, reference, candidate) << " expected " << expected << '\n';
+			if (lcs_length(masks, candidate) != expected.size())
+				std::cerr << "Mismatch: " << lcs_length(masks, candidate) << " expected " << expected.size() << '\n';
+#endif
+			}
+		}
+}
+
 // string tokenise
 auto split(const string &value, char delimiter) -> vector<string>
 {
@@ -70,55 +191,300 @@ auto split(const string &value, char delimiter) -> vector<string>
 }
 
 // longest common subsequence
-auto lcs(string &str1, string &str2) -> string
+auto lcs(string &str1, string &str2, size_t budget) -> string
 {
-	vector<vector<int>> distances = table(str1, str2);
+	size_t bytes = (str1.size() + 1) * (str2.size() + 1) * sizeof(int);
+	if (bytes > budget)
+		return lcs_linear(str1, str2);
+
+	Table distances = table(str1, str2);
 
 	return reconstruct(distances, str1, str2);
 }
 
+// length of the longest common subsequence, without building the O(nm) table
+auto lcs_length(const string &str1, const string &str2) -> size_t
+{
+	// the bits are laid over the shorter string, so there are fewer words per step
+	if (str1.size() < str2.size())
+		return lcs_length(MatchMasks(str1), str2);
+	else
+		return lcs_length(MatchMasks(str2), str1);
+}
+
+MatchMasks::MatchMasks(const string &str)
+	: length(str.size())
+	, words((str.size() + 63) / 64)
+	, bits(256 * words, 0)
+{
+	for (size_t i = 0; i < length; ++i)
+		{
+		unsigned char c = str[i];
+		bits[c * words + i / 64] |= uint64_t(1) << (i % 64);
+		}
+}
+
+// one row of the bit-parallel lcs over `words` words: v = (v + (v & m)) | (v & ~m), the addition carrying across words
+static auto advance(uint64_t *v, const uint64_t *m, size_t words) -> void
+{
+	uint64_t carry = 0;
+	size_t k = 0;
+
+#if defined __AVX2__
+	// four words at a time. Within a block the carries are resolved from the generate and propagate bits of each word
+	const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+	const __m256i ones = _mm256_set1_epi64x(-1);
+	const __m256i lanes = _mm256_set_epi64x(8, 4, 2, 1);
+
+	for (; k + 4 <= words; k += 4)
+		{
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + k));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(m + k));
+		__m256i u = _mm256_and_si256(x, y);
+		__m256i sum = _mm256_add_epi64(x, u);
+
+		// unsigned sum < x generates a carry, sum of all ones propagates one
+		__m256i generate = _mm256_cmpgt_epi64(_mm256_xor_si256(x, sign), _mm256_xor_si256(sum, sign));
+		__m256i propagate = _mm256_cmpeq_epi64(sum, ones);
+		unsigned g = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(generate)));
+		unsigned p = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(propagate)));
+
+		unsigned incoming = (((g << 1) | static_cast<unsigned>(carry)) + p) ^ p;
+		carry = (incoming >> 4) & 1;
+
+		// subtracting all ones adds the incoming carry to each lane that receives one
+		__m256i add = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(incoming & 0xF), lanes), lanes);
+		sum = _mm256_sub_epi64(sum, add);
+
+		__m256i result = _mm256_or_si256(sum, _mm256_andnot_si256(y, x));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(v + k), result);
+		}
+#endif
+
+	for (; k < words; ++k)
+		{
+		uint64_t x = v[k];
+		uint64_t u = x & m[k];
+		uint64_t sum1 = x + u;
+		uint64_t sum2 = sum1 + carry;
+		carry = (sum1 < x) | (sum2 < sum1);
+		v[k] = sum2 | (x & ~m[k]);
+		}
+}
+
+// number of set bits in the word, portably. Compilers lower this to a single popcnt instruction where the target has one
+static auto popcount(uint64_t word) -> size_t
+{
+	return std::bitset<64>(word).count();
+}
+
+// length of the longest common subsequence of `other` and the string behind `masks` (Allison-Dix / Hyyro bit-vector algorithm)
+auto lcs_length(const MatchMasks &masks, const string &other) -> size_t
+{
+	if (masks.words == 0 || other.empty())
+		return 0;
+
+	// a zero bit marks each position at which the lcs so far has grown. Padding bits beyond `length` stay set
+	vector<uint64_t> v(masks.words, ~uint64_t(0));
+
+	for (unsigned char c : other)
+		advance(v.data(), masks[c], masks.words);
+
+	size_t set = 0;
+	for (uint64_t word : v)
+		set += popcount(word);
+
+	return masks.words * 64 - set;
+}
+
+// number of zero bits among the first `n` bits of `v`, i.e. the value of the table cell at column `n` of the row `v` stands for
+static auto zeros(const uint64_t *v, size_t n) -> size_t
+{
+	size_t set = 0;
+	for (size_t k = 0; k < n / 64; ++k)
+		set += popcount(v[k]);
+	if (n % 64 != 0)
+		set += popcount(v[n / 64] & ((uint64_t(1) << (n % 64)) - 1));
+
+	return n - set;
+}
+
+static auto bit(const uint64_t *v, size_t j) -> bool
+{
+	return (v[j / 64] >> (j % 64) & 1) != 0;
+}
+
+// Follow the same backtracking path as `reconstruct()` from (r1, c) up to row r0, appending the matches to `out` as they are met.
+// `top` is the bit-vector form of table row r0. Returns the column at which the path reaches row r0.
+// With `transposed` the table is the transpose of the one `reconstruct()` backtracks through, so ties are broken the other way
+static auto walk(const string &a, const string &b, const MatchMasks &masks, size_t r0, size_t r1, size_t c, const vector<uint64_t> &top, bool transposed, string &out) -> size_t
+{
+	if (r1 == r0 || c == 0)
+		return c;
+
+	// only the words covering columns up to `c` influence the path from here
+	size_t words = (c + 63) / 64;
+	vector<uint64_t> v(top.begin(), top.begin() + words);
+
+	if (r1 == r0 + 1)
+		{
+		advance(v.data(), masks[a[r0]], words);
+
+		// the values of the cells at column j of rows r0 and r1
+		size_t above = transposed ? zeros(top.data(), c) : 0;
+		size_t here = transposed ? zeros(v.data(), c) : 0;
+
+		// along row r1, moving left while the table value there doesn't drop, as `reconstruct()` does
+		size_t j = c;
+		while (j > 0)
+			{
+			if (a[r0] == b[j - 1])
+				{
+				out.append(1, a[r0]);
+				return j - 1;
+				}
+			else if (!transposed && !bit(v.data(), j - 1))
+				{
+				return j;
+				}
+			else if (transposed)
+				{
+				// here the path only goes left when that keeps a greater value than going up would
+				size_t left = here - (bit(v.data(), j - 1) ? 0 : 1);
+				if (left <= above)
+					return j;
+
+				here = left;
+				above -= bit(top.data(), j - 1) ? 0 : 1;
+				}
+			j--;
+			}
+		return 0;
+		}
+
+	// row mid from row r0, then the lower half of the path, then the upper half starting where the lower half left off
+	size_t mid = r0 + (r1 - r0) / 2;
+	for (size_t i = r0; i < mid; ++i)
+		advance(v.data(), masks[a[i]], words);
+
+	size_t j = walk(a, b, masks, mid, r1, c, v, transposed, out);
+	v = vector<uint64_t>();
+	return walk(a, b, masks, r0, mid, j, top, transposed, out);
+}
+
+// longest common subsequence, identical to the one `reconstruct()` gives, in O(n + m) space and O(nm log(n) / 64) time.
+// Hirschberg style, halving the rows each time, but the table rows are carried as bit vectors of the differences between adjacent cells
+auto lcs_linear(const string &str1, const string &str2) -> string
+{
+	string lcs;
+
+	MatchMasks masks(str2);
+	vector<uint64_t> top(masks.words, ~uint64_t(0)); // row zero
+	walk(str1, str2, masks, 0, str1.size(), str2.size(), top, false, lcs);
+
+	std::reverse(lcs.begin(), lcs.end());
+	return lcs;
+}
+
+// the same lcs as `lcs(reference, candidate)` gives, where `masks` are those of `reference` and so can be shared by many candidates
+auto lcs_linear(const MatchMasks &masks, const string &reference, const string &candidate) -> string
+{
+	string lcs;
+
+	// walking the transposed table, candidate down the rows and reference across the columns
+	vector<uint64_t> top(masks.words, ~uint64_t(0));
+	walk(candidate, reference, masks, 0, candidate.size(), reference.size(), top, true, lcs);
+
+	std::reverse(lcs.begin(), lcs.end());
+	return lcs;
+}
+
+// Tiled wavefront. `tile(ti, tj)` is called for every tile of a `tileRows` x `tileCols` grid, once the tiles above and to the left of it are done.
+// Each thread takes every `threads`th row of tiles and works along it, so the tiles of one anti-diagonal are filled at the same time.
+template<typename Tile>
+auto wavefront(size_t tileRows, size_t tileCols, unsigned threads, Tile &&tile) -> void
+{
+	threads = std::max(1u, std::min(threads, static_cast<unsigned>(std::min<size_t>(tileRows, 1024))));
+
+	// the number of tiles done along each row of tiles
+	std::unique_ptr<std::atomic<size_t>[]> progress(new std::atomic<size_t>[tileRows]);
+	for (size_t ti = 0; ti < tileRows; ++ti)
+		progress[ti].store(0, std::memory_order_relaxed);
+
+	auto work = [&](unsigned first)
+		{
+		for (size_t ti = first; ti < tileRows; ti += threads)
+			{
+			for (size_t tj = 0; tj < tileCols; ++tj)
+				{
+				// the tile to the left is our own, the one above may still be in progress
+				if (ti > 0)
+					{
+					while (progress[ti - 1].load(std::memory_order_acquire) <= tj)
+						std::this_thread::yield();
+					}
+
+				tile(ti, tj);
+				progress[ti].store(tj + 1, std::memory_order_release);
+				}
+			}
+		};
+
+	vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; ++t)
+		pool.emplace_back(work, t);
+	work(0);
+
+	for (auto &thread : pool)
+		thread.join();
+}
+
 // build the dynamic programming edit distance table
-auto table(string &str1, string &str2) -> vector<vector<int>>
+auto table(const string &str1, const string &str2, unsigned threads) -> Table
 {
 	size_t rows = str1.size() + 1;
 	size_t cols = str2.size() + 1;
 
-	vector<vector<int>> distances;
+	// constructed with the first row and column zero
+	Table distances(rows, cols);
 
-	// construct and initialize
-	for (size_t r = 0; r < rows; ++r)
-		distances.emplace_back(vector<int>(cols));
-	for (size_t c = 0; c < cols; ++c)
-		distances[0][c] = 0;
-	for (size_t r = 0; r < rows; ++r)
-		distances[r][0] = 0;
+	size_t tileRows = (rows - 1 + tile_size - 1) / tile_size;
+	size_t tileCols = (cols - 1 + tile_size - 1) / tile_size;
 
 	// fill
-	for (size_t i = 1; i < rows; ++i)
+	wavefront(tileRows, tileCols, threads, [&](size_t ti, size_t tj)
 		{
-		for (size_t j = 1; j < cols; ++j)
+		size_t r0 = 1 + ti * tile_size;
+		size_t r1 = std::min(rows, r0 + tile_size);
+		size_t c0 = 1 + tj * tile_size;
+		size_t c1 = std::min(cols, c0 + tile_size);
+
+		for (size_t i = r0; i < r1; ++i)
 			{
-			int a = distances[i - 1][j - 1] + 1;
-			int b = distances[i - 1][j];
-			int c = distances[i][j - 1];
-
-			if (str1[i - 1] == str2[j - 1])
-				distances[i][j] = a;
-			else
-				distances[i][j] = std::max(b, c);
+			const int *above = distances[i - 1];
+			int *row = distances[i];
+			char a = str1[i - 1];
+
+			for (size_t j = c0; j < c1; ++j)
+				{
+				if (a == str2[j - 1])
+					row[j] = above[j - 1] + 1;
+				else
+					row[j] = std::max(above[j], row[j - 1]);
+				}
 			}
-		}
+		});
 
 	return distances;
 }
 
 // backtrack through the distance table for the lcs
-auto reconstruct(const vector<vector<int>> &d, const string &a, const string &b) -> string
+auto reconstruct(const Table &d, const string &a, const string &b) -> string
 {
 	string lcs;
 
-	size_t i = d.size() - 1;
-	size_t j = d[0].size() - 1;
+	size_t i = d.rows - 1;
+	size_t j = d.cols - 1;
 
 	while (i > 0 && j > 0)
 		{
@@ -143,10 +509,10 @@ auto reconstruct(const vector<vector<int>> &d, const string &a, const string &b)
 }
 
 // debug print the table
-auto print(vector<vector<int>> distances) -> void
+auto print(const Table &distances) -> void
 {
-	size_t rows = distances.size();
-	size_t cols = distances[0].size();
+	size_t rows = distances.rows;
+	size_t cols = distances.cols;
 
 	for (size_t j = 0; j < rows; ++j)
 		{
@@ -158,3 +524,96 @@ auto print(vector<vector<int>> distances) -> void
 		}
 	cout << '\n';
 }
+
+#if defined do_benchmark
+// last row of the table, filled by the same wavefront of tiles but keeping only two rows and one column, so that long inputs fit in memory
+static auto last_row(const string &str1, const string &str2, unsigned threads) -> vector<int>
+{
+	size_t rows = str1.size() + 1;
+	size_t cols = str2.size() + 1;
+
+	size_t tileRows = (rows - 1 + tile_size - 1) / tile_size;
+	size_t tileCols = (cols - 1 + tile_size - 1) / tile_size;
+
+	// a row of tiles writes its bottom row to one slot while the next row of tiles reads from it, and reads the row above from the other.
+	// The row of tiles after next only overwrites a tile's width of a slot once the one in between is done with it
+	vector<int> slots[2] = { vector<int>(cols, 0), vector<int>(cols, 0) };
+	vector<int> left(rows, 0);       // right hand column of the last tile done in each row of tiles
+	vector<int> corner(tileRows, 0); // cell above and to the left of the next tile in each row of tiles
+
+	wavefront(tileRows, tileCols, threads, [&](size_t ti, size_t tj)
+		{
+		size_t r0 = 1 + ti * tile_size;
+		size_t r1 = std::min(rows, r0 + tile_size);
+		size_t c0 = 1 + tj * tile_size;
+		size_t c1 = std::min(cols, c0 + tile_size);
+
+		const int *top = ti == 0 ? slots[1].data() : slots[(ti + 1) % 2].data();
+		int *bottom = slots[ti % 2].data();
+
+		int row[tile_size + 1];
+		int above[tile_size + 1];
+		above[0] = corner[ti];
+		std::copy(top + c0, top + c1, above + 1);
+		corner[ti] = top[c1 - 1];
+
+		for (size_t i = r0; i < r1; ++i)
+			{
+			char a = str1[i - 1];
+			row[0] = left[i];
+
+			for (size_t j = c0; j < c1; ++j)
+				{
+				size_t k = j - c0 + 1;
+				if (a == str2[j - 1])
+					row[k] = above[k - 1] + 1;
+				else
+					row[k] = std::max(above[k], row[k - 1]);
+				}
+
+			left[i] = row[c1 - c0];
+			std::copy(row, row + (c1 - c0 + 1), above);
+			}
+
+		std::copy(above + 1, above + (c1 - c0 + 1), bottom + c0);
+		});
+
+	return rows > 1 ? slots[(rows - 2) / tile_size % 2] : slots[1];
+}
+
+// cells filled per second for random inputs of the given lengths, with one thread up to the number of cores
+auto benchmark(const vector<size_t> &lengths) -> void
+{
+	std::mt19937 rng(6);
+	std::uniform_int_distribution<int> letter(0, 3);
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+	for (size_t n : lengths)
+		{
+		string str1(n, ' ');
+		string str2(n, ' ');
+		for (auto &c : str1)
+			c = "ACGT"[letter(rng)];
+		for (auto &c : str2)
+			c = "ACGT"[letter(rng)];
+
+		double single = 0.0;
+		for (unsigned threads = 1; ; threads = std::min(threads * 2, cores))
+			{
+			auto start = std::chrono::steady_clock::now();
+			vector<int> row = last_row(str1, str2, threads);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			double cells = double(n) * double(n) / elapsed.count();
+			if (threads == 1)
+				single = cells;
+
+			cout << "length " << n << ", threads " << threads << ": " << elapsed.count() << " s, "
+				<< cells / 1e9 << " Gcells/s, speedup " << cells / single << " (lcs " << row.back() << ")\n";
+
+			if (threads == cores)
+				break;
+			}
+		}
+}
+#endif